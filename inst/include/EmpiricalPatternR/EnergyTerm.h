@@ -0,0 +1,88 @@
+#ifndef EMPIRICALPATTERNR_ENERGYTERM_H
+#define EMPIRICALPATTERNR_ENERGYTERM_H
+
+#include <Rcpp.h>
+
+// ==============================================================================
+// ENERGY TERM PLUGIN API
+// ==============================================================================
+// Interface between the native annealer (anneal_stand_native()) and the terms
+// of its energy. A term keeps whatever state it needs to score the stand
+// incrementally; the annealer drives it through
+//
+//   init(stand)         full stand, before the first proposal; returns energy
+//   propose(stand, p)   energy change if proposal p were applied (the stand
+//                       still holds the old state); the term keeps p pending
+//   commit()            p was accepted; the annealer then updates the stand
+//   rollback()          p was rejected; restore the state before propose()
+//
+// Exactly one of commit() / rollback() follows every propose(). Energies are
+// weighted contributions to the total, so a term scales itself.
+//
+// Other packages implement terms with
+//
+//   LinkingTo: Rcpp, EmpiricalPatternR
+//   #include <EmpiricalPatternR/EnergyTerm.h>
+//
+// and hand them to R with EmpiricalPatternR::wrapEnergyTerm(new MyTerm(...)),
+// which tags the external pointer so the annealer can check what it receives.
+// Pass the result in the `extra_terms` list of anneal_stand_native().
+//
+// The annealer only calls terms from one thread at a time. A term object
+// belongs to one run at a time; init() resets it for reuse.
+
+namespace EmpiricalPatternR {
+
+// Bumped whenever Stand, Proposal or EnergyTerm change layout
+const int ENERGY_TERM_API_VERSION = 1;
+
+// External pointer tag of wrapped terms
+const char* const ENERGY_TERM_TAG = "EmpiricalPatternR::EnergyTerm";
+
+// Read-only view of the stand owned by the annealer. Attribute arrays follow
+// calc_tree_attributes(); species are 0-based codes into the species of the
+// run (the names of targets$species_props).
+struct Stand {
+    int n, n_species;
+    double plot_size;
+    const double *x, *y, *dbh;
+    const double *height, *crown_radius, *crown_base, *fuel_mass;
+    const int* species;
+};
+
+enum ProposalType { PROPOSE_MOVE = 1, PROPOSE_SPECIES = 2, PROPOSE_DBH = 3 };
+
+struct TreeState {
+    double x, y, dbh;
+    double height, crown_radius, crown_base, fuel_mass;
+    int species;
+};
+
+// A proposal changes one tree; before and after hold all of its fields (the
+// attributes in `after` are already re-derived for a species or DBH change)
+struct Proposal {
+    int type;
+    int tree;
+    TreeState before, after;
+};
+
+class EnergyTerm {
+public:
+    virtual ~EnergyTerm() {}
+    virtual int apiVersion() const { return ENERGY_TERM_API_VERSION; }
+    virtual const char* name() const = 0;
+    virtual double init(const Stand& stand) = 0;
+    virtual double propose(const Stand& stand, const Proposal& p) = 0;
+    virtual void commit() = 0;
+    virtual void rollback() = 0;
+};
+
+// Hand a term to R; R owns it from here and deletes it when collected
+inline SEXP wrapEnergyTerm(EnergyTerm* term) {
+    Rcpp::XPtr<EnergyTerm> ptr(term, true, Rf_install(ENERGY_TERM_TAG), R_NilValue);
+    return ptr;
+}
+
+}
+
+#endif
@@ -0,0 +1,220 @@
+#ifndef EMPIRICALPATTERNR_ALLOMETRY_H
+#define EMPIRICALPATTERNR_ALLOMETRY_H
+
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+// ==============================================================================
+// FUSED ALLOMETRY KERNEL
+// ==============================================================================
+// All tree attributes derived from DBH in one call, with the same equations
+// and bounds as calc_height, calc_crown_radius, calc_crown_base_height and
+// calc_canopy_fuel_mass. Coefficients come from R as one row per species
+// (see allometry_coef_matrix()), in the column order of AllometryCoefs.
+
+enum { CBH_RATIO = 0, CBH_REESE = 1 };
+enum { FOLIAGE_CROWN_VOLUME = 0, FOLIAGE_MILLER = 1 };
+
+const int ALLOMETRY_N_COEFS = 15;
+
+struct AllometryCoefs {
+    double h_a, h_b;              // height = 1.3 + a * (1 - exp(-b * D))
+    double cd_a, cd_b, cd_c;      // ln(CD) = a + b ln(D) + c ln(H)
+    double cbh[6];                // Reese: b0 + b1 H + b2 D + b3 H^2 + b4 D^2 + b5 H D
+    double cr_a, cr_b;            // crown ratio = a - b ln(D)
+    double fm_a, fm_b;            // Miller: ln(W) = a + b ln(D); crown volume: W = a D^b
+
+    // Read row `row` of a column-major n_rows x ALLOMETRY_N_COEFS matrix
+    void load(const double* m, int n_rows, int row) {
+        double* dst[ALLOMETRY_N_COEFS] = {
+            &h_a, &h_b, &cd_a, &cd_b, &cd_c, &cbh[0], &cbh[1], &cbh[2], &cbh[3],
+            &cbh[4], &cbh[5], &cr_a, &cr_b, &fm_a, &fm_b
+        };
+        for(int k = 0; k < ALLOMETRY_N_COEFS; k++) *dst[k] = m[(size_t)k * n_rows + row];
+    }
+};
+
+struct TreeSize {
+    double height, crown_radius, crown_base, fuel_mass;
+};
+
+inline TreeSize evalAllometry(const AllometryCoefs& p, int cbh_method,
+                              int foliage_method, double dbh) {
+    TreeSize t;
+    double log_d = log(std::max(dbh, 1.0));
+    t.height = 1.3 + p.h_a * (1.0 - exp(-p.h_b * dbh));
+
+    double log_cd = p.cd_a + p.cd_b * log_d + p.cd_c * log(std::max(t.height, 1.3));
+    t.crown_radius = std::max(exp(log_cd) / 2.0, 0.3);
+
+    if(cbh_method == CBH_REESE) {
+        double H = t.height, D = dbh;
+        double cbh = p.cbh[0] + p.cbh[1] * H + p.cbh[2] * D + p.cbh[3] * H * H +
+                     p.cbh[4] * D * D + p.cbh[5] * H * D;
+        t.crown_base = std::min(std::max(cbh, 1.3), 0.9 * H);
+    } else {
+        double ratio = std::min(std::max(p.cr_a - p.cr_b * log_d, 0.3), 0.9);
+        t.crown_base = std::max(t.height * (1.0 - ratio), 1.3);
+    }
+
+    t.fuel_mass = foliage_method == FOLIAGE_MILLER ? exp(p.fm_a + p.fm_b * log_d)
+                                                   : p.fm_a * pow(dbh, p.fm_b);
+    return t;
+}
+
+// ==============================================================================
+// COMPILED ALLOMETRIC EQUATIONS
+// ==============================================================================
+// Equations written as R expressions are compiled by compile_allometry() into
+// postfix bytecode: one program per species and attribute (height, crown
+// radius, crown base, fuel mass, in that order), each ending in OP_END.
+// Instruction i is (op[i], arg[i]); arg holds the value of OP_CONST and the
+// variable index of OP_VAR. Species parameters are already folded into the
+// constants, so a program reads only DBH and the attributes computed before
+// it (variables 0..k for attribute k).
+//
+// eval() runs the programs for one tree. evalBlock() runs them for a block of
+// trees of one species, one instruction at a time over the whole block, so
+// the dispatch cost is shared by the block and the inner loops vectorize.
+
+enum { OP_END = 0, OP_CONST, OP_VAR, OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_POW,
+       OP_NEG, OP_EXP, OP_LOG, OP_SQRT, OP_ABS, OP_MIN, OP_MAX, OP_COUNT };
+
+const int ALLOMETRY_N_ATTRS = 4;      // height, crown radius, crown base, fuel mass
+const int ALLOMETRY_MAX_STACK = 16;
+const int ALLOMETRY_BLOCK = 256;
+
+class AllometryProgram {
+public:
+    // entry: column-major n_species x ALLOMETRY_N_ATTRS start offsets
+    AllometryProgram(const int* op, const double* arg, int n_code,
+                     const int* entry, int n_species)
+        : op_(op, op + n_code), arg_(arg, arg + n_code),
+          entry_(entry, entry + (size_t)n_species * ALLOMETRY_N_ATTRS),
+          n_species_(n_species) {}
+
+    int nSpecies() const { return n_species_; }
+
+    // Every program stays inside the code, keeps its stack within bounds and
+    // reads only the variables available to its attribute
+    bool valid() const {
+        int n_code = (int)op_.size();
+        for(int s = 0; s < n_species_; s++) {
+            for(int k = 0; k < ALLOMETRY_N_ATTRS; k++) {
+                int depth = 0;
+                for(int pc = entry(s, k); ; pc++) {
+                    if(pc < 0 || pc >= n_code) return false;
+                    int o = op_[pc];
+                    if(o == OP_END) {
+                        if(depth != 1) return false;
+                        break;
+                    }
+                    if(o == OP_VAR && (arg_[pc] < 0 || (int)arg_[pc] > k)) return false;
+                    if(o == OP_CONST || o == OP_VAR) depth++;
+                    else if(o >= OP_NEG && o <= OP_ABS) { if(depth < 1) return false; }
+                    else if(o > OP_END && o < OP_COUNT) { if(depth-- < 2) return false; }
+                    else return false;
+                    if(depth > ALLOMETRY_MAX_STACK) return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // All attributes of one tree
+    TreeSize eval(int species, double dbh) const {
+        double v[ALLOMETRY_N_ATTRS + 1] = {dbh, 0.0, 0.0, 0.0, 0.0};
+        for(int k = 0; k < ALLOMETRY_N_ATTRS; k++) v[k + 1] = run(entry(species, k), v);
+        TreeSize t;
+        t.height = v[1];
+        t.crown_radius = v[2];
+        t.crown_base = v[3];
+        t.fuel_mass = v[4];
+        return t;
+    }
+
+    // Attributes of n <= ALLOMETRY_BLOCK trees of one species. var[0] holds
+    // their DBH; var[1..4] receive height, crown radius, crown base and fuel
+    // mass. stack is scratch space of ALLOMETRY_MAX_STACK * ALLOMETRY_BLOCK.
+    void evalBlock(int species, int n, double* const* var, double* stack) const {
+        for(int k = 0; k < ALLOMETRY_N_ATTRS; k++) {
+            runBlock(entry(species, k), n, var, stack, var[k + 1]);
+        }
+    }
+
+private:
+    std::vector<int> op_;
+    std::vector<double> arg_;
+    std::vector<int> entry_;
+    int n_species_;
+
+    int entry(int species, int k) const { return entry_[(size_t)k * n_species_ + species]; }
+
+    double run(int pc, const double* v) const {
+        double s[ALLOMETRY_MAX_STACK];
+        int top = -1;
+        for(;; pc++) {
+            switch(op_[pc]) {
+            case OP_END:   return s[top];
+            case OP_CONST: s[++top] = arg_[pc]; break;
+            case OP_VAR:   s[++top] = v[(int)arg_[pc]]; break;
+            case OP_ADD:   top--; s[top] += s[top + 1]; break;
+            case OP_SUB:   top--; s[top] -= s[top + 1]; break;
+            case OP_MUL:   top--; s[top] *= s[top + 1]; break;
+            case OP_DIV:   top--; s[top] /= s[top + 1]; break;
+            case OP_POW:   top--; s[top] = pow(s[top], s[top + 1]); break;
+            case OP_MIN:   top--; s[top] = std::min(s[top], s[top + 1]); break;
+            case OP_MAX:   top--; s[top] = std::max(s[top], s[top + 1]); break;
+            case OP_NEG:   s[top] = -s[top]; break;
+            case OP_EXP:   s[top] = exp(s[top]); break;
+            case OP_LOG:   s[top] = log(s[top]); break;
+            case OP_SQRT:  s[top] = sqrt(s[top]); break;
+            case OP_ABS:   s[top] = fabs(s[top]); break;
+            }
+        }
+    }
+
+    void runBlock(int pc, int n, double* const* var, double* stack, double* out) const {
+        int top = -1;
+        for(;; pc++) {
+            int o = op_[pc];
+            if(o == OP_END) {
+                std::copy(stack + (size_t)top * ALLOMETRY_BLOCK,
+                          stack + (size_t)top * ALLOMETRY_BLOCK + n, out);
+                return;
+            }
+            if(o == OP_CONST || o == OP_VAR) {
+                double* a = stack + (size_t)(++top) * ALLOMETRY_BLOCK;
+                if(o == OP_CONST) std::fill(a, a + n, arg_[pc]);
+                else std::copy(var[(int)arg_[pc]], var[(int)arg_[pc]] + n, a);
+                continue;
+            }
+            if(o >= OP_NEG && o <= OP_ABS) {
+                double* a = stack + (size_t)top * ALLOMETRY_BLOCK;
+                switch(o) {
+                case OP_NEG:  for(int i = 0; i < n; i++) a[i] = -a[i]; break;
+                case OP_EXP:  for(int i = 0; i < n; i++) a[i] = exp(a[i]); break;
+                case OP_LOG:  for(int i = 0; i < n; i++) a[i] = log(a[i]); break;
+                case OP_SQRT: for(int i = 0; i < n; i++) a[i] = sqrt(a[i]); break;
+                case OP_ABS:  for(int i = 0; i < n; i++) a[i] = fabs(a[i]); break;
+                }
+                continue;
+            }
+            top--;
+            double* a = stack + (size_t)top * ALLOMETRY_BLOCK;
+            const double* b = a + ALLOMETRY_BLOCK;
+            switch(o) {
+            case OP_ADD: for(int i = 0; i < n; i++) a[i] += b[i]; break;
+            case OP_SUB: for(int i = 0; i < n; i++) a[i] -= b[i]; break;
+            case OP_MUL: for(int i = 0; i < n; i++) a[i] *= b[i]; break;
+            case OP_DIV: for(int i = 0; i < n; i++) a[i] /= b[i]; break;
+            case OP_POW: for(int i = 0; i < n; i++) a[i] = pow(a[i], b[i]); break;
+            case OP_MIN: for(int i = 0; i < n; i++) a[i] = std::min(a[i], b[i]); break;
+            case OP_MAX: for(int i = 0; i < n; i++) a[i] = std::max(a[i], b[i]); break;
+            }
+        }
+    }
+};
+
+#endif
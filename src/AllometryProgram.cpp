@@ -0,0 +1,91 @@
+#include <Rcpp.h>
+#include <vector>
+#include <algorithm>
+#include "Allometry.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace Rcpp;
+using namespace std;
+
+// ==============================================================================
+// TREE ATTRIBUTES FROM COMPILED EQUATIONS
+// ==============================================================================
+// Runs the bytecode produced by compile_allometry() over a whole stand. Trees
+// are grouped by species (counting sort) and cut into blocks of at most
+// ALLOMETRY_BLOCK trees of one species; each block gathers its DBH, runs the
+// species' programs with AllometryProgram::evalBlock and scatters the results.
+// Blocks are independent and run in parallel.
+
+// [[Rcpp::plugins(openmp)]]
+// [[Rcpp::export]]
+List calcAllometryProgramCpp(NumericVector dbh, IntegerVector species, IntegerVector op,
+                             NumericVector arg, IntegerMatrix entry, int n_threads = 0) {
+    int n = dbh.size();
+    int n_species = entry.nrow();
+    if(species.size() != n) stop("dbh and species must have the same length");
+    if(op.size() != arg.size() || entry.ncol() != ALLOMETRY_N_ATTRS) {
+        stop("op and arg must have the same length and entry %d columns", ALLOMETRY_N_ATTRS);
+    }
+    AllometryProgram prog(op.begin(), arg.begin(), op.size(), entry.begin(), n_species);
+    if(!prog.valid()) stop("invalid allometry program");
+
+    // Trees ordered by species
+    vector<int> first(n_species + 1, 0), order(n);
+    for(int i = 0; i < n; i++) {
+        int s = species[i] - 1;
+        if(s < 0 || s >= n_species) stop("species codes must be in 1..%d", n_species);
+        first[s + 1]++;
+    }
+    for(int s = 0; s < n_species; s++) first[s + 1] += first[s];
+    vector<int> fill(first.begin(), first.end() - 1);
+    for(int i = 0; i < n; i++) order[fill[species[i] - 1]++] = i;
+
+    // Blocks of one species: (species, begin, end) into order
+    vector<int> block_sp, block_begin, block_end;
+    for(int s = 0; s < n_species; s++) {
+        for(int b = first[s]; b < first[s + 1]; b += ALLOMETRY_BLOCK) {
+            block_sp.push_back(s);
+            block_begin.push_back(b);
+            block_end.push_back(min(b + ALLOMETRY_BLOCK, first[s + 1]));
+        }
+    }
+    int n_blocks = (int)block_sp.size();
+
+    NumericVector height(n), crown_radius(n), crown_base(n), fuel_mass(n);
+    const double* pd = dbh.begin();
+    double* out[ALLOMETRY_N_ATTRS] = {height.begin(), crown_radius.begin(),
+                                      crown_base.begin(), fuel_mass.begin()};
+
+    #ifdef _OPENMP
+    if(n_threads > 0) {
+        omp_set_num_threads(n_threads);
+    }
+    #pragma omp parallel if(n_blocks > 1)
+    #endif
+    {
+        vector<double> buf((size_t)(ALLOMETRY_N_ATTRS + 1) * ALLOMETRY_BLOCK);
+        vector<double> stack((size_t)ALLOMETRY_MAX_STACK * ALLOMETRY_BLOCK);
+        double* var[ALLOMETRY_N_ATTRS + 1];
+        for(int k = 0; k <= ALLOMETRY_N_ATTRS; k++) var[k] = &buf[(size_t)k * ALLOMETRY_BLOCK];
+
+        #ifdef _OPENMP
+        #pragma omp for schedule(dynamic)
+        #endif
+        for(int b = 0; b < n_blocks; b++) {
+            int begin = block_begin[b], m = block_end[b] - begin;
+            for(int j = 0; j < m; j++) var[0][j] = pd[order[begin + j]];
+            prog.evalBlock(block_sp[b], m, var, stack.data());
+            for(int k = 0; k < ALLOMETRY_N_ATTRS; k++) {
+                for(int j = 0; j < m; j++) out[k][order[begin + j]] = var[k + 1][j];
+            }
+        }
+    }
+
+    return List::create(Named("height") = height,
+                        Named("crown_radius") = crown_radius,
+                        Named("crown_base") = crown_base,
+                        Named("fuel_mass") = fuel_mass);
+}
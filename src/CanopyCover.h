@@ -0,0 +1,680 @@
+#ifndef EMPIRICALPATTERNR_CANOPYCOVER_H
+#define EMPIRICALPATTERNR_CANOPYCOVER_H
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <unordered_map>
+
+// ==============================================================================
+// CROWN SHAPES
+// ==============================================================================
+// The cover kernels rasterize crowns one raster row at a time: a shape reports
+// the x-interval of its row chord, and every cell centre in that interval is
+// filled as one span. Shapes are template policies, so the circular crowns
+// used by the simulation compile to the plain disc test with no per-cell
+// dispatch, while measured crowns can be ellipses with an offset centroid.
+//
+// A shape provides:
+//   size()                    number of crowns
+//   bounds(i, box)            bounding box of crown i; false if it has no area
+//   chord(i, py, x_lo, x_hi)  x-extent of crown i on the line y = py
+//   contains(i, px, py)       exact point test, used to settle span ends
+
+struct CrownBox {
+    double x_lo, x_hi, y_lo, y_hi;
+};
+
+struct CircleCrowns {
+    const double* x;
+    const double* y;
+    const double* r;
+    int n;
+
+    CircleCrowns(const double* x_, const double* y_, const double* r_, int n_)
+        : x(x_), y(y_), r(r_), n(n_) {}
+
+    int size() const { return n; }
+
+    bool bounds(int i, CrownBox& box) const {
+        if(!(r[i] >= 0)) return false;
+        box.x_lo = x[i] - r[i];
+        box.x_hi = x[i] + r[i];
+        box.y_lo = y[i] - r[i];
+        box.y_hi = y[i] + r[i];
+        return true;
+    }
+
+    bool chord(int i, double py, double& x_lo, double& x_hi) const {
+        double dy = py - y[i];
+        double w_sq = r[i] * r[i] - dy * dy;
+        if(w_sq < 0) return false;
+        double w = sqrt(w_sq);
+        x_lo = x[i] - w;
+        x_hi = x[i] + w;
+        return true;
+    }
+
+    bool contains(int i, double px, double py) const {
+        double dx = px - x[i], dy = py - y[i];
+        return dx * dx + dy * dy <= r[i] * r[i];
+    }
+};
+
+// Ellipse with semi-axes a (along `angle`, radians counter-clockwise from the
+// x axis) and b, centred at the stem position plus (offset_x, offset_y). In
+// centre-relative coordinates (u, v) the crown is A u^2 + B v u + C v^2 <= 1,
+// so each chord is one quadratic solve with per-crown constants.
+struct EllipseCrowns {
+    std::vector<double> cx, cy, qa, qb, qc, half_w, half_h;
+
+    EllipseCrowns(const double* x, const double* y, const double* a,
+                  const double* b, const double* angle, const double* offset_x,
+                  const double* offset_y, int n)
+        : cx(n), cy(n), qa(n), qb(n), qc(n), half_w(n), half_h(n) {
+        for(int i = 0; i < n; i++) {
+            cx[i] = x[i] + offset_x[i];
+            cy[i] = y[i] + offset_y[i];
+            if(!(a[i] > 0 && b[i] > 0)) {
+                half_h[i] = -1.0;
+                continue;
+            }
+            double c = cos(angle[i]), s = sin(angle[i]);
+            double ia = 1.0 / (a[i] * a[i]), ib = 1.0 / (b[i] * b[i]);
+            qa[i] = c * c * ia + s * s * ib;
+            qb[i] = 2.0 * c * s * (ia - ib);
+            qc[i] = s * s * ia + c * c * ib;
+            half_w[i] = sqrt(a[i] * a[i] * c * c + b[i] * b[i] * s * s);
+            half_h[i] = sqrt(a[i] * a[i] * s * s + b[i] * b[i] * c * c);
+        }
+    }
+
+    int size() const { return (int)cx.size(); }
+
+    bool bounds(int i, CrownBox& box) const {
+        if(half_h[i] < 0) return false;
+        box.x_lo = cx[i] - half_w[i];
+        box.x_hi = cx[i] + half_w[i];
+        box.y_lo = cy[i] - half_h[i];
+        box.y_hi = cy[i] + half_h[i];
+        return true;
+    }
+
+    bool chord(int i, double py, double& x_lo, double& x_hi) const {
+        if(half_h[i] < 0) return false;
+        double v = py - cy[i];
+        double B = qb[i] * v;
+        double disc = B * B - 4.0 * qa[i] * (qc[i] * v * v - 1.0);
+        if(disc < 0) return false;
+        double root = sqrt(disc);
+        x_lo = cx[i] + (-B - root) / (2.0 * qa[i]);
+        x_hi = cx[i] + (-B + root) / (2.0 * qa[i]);
+        return true;
+    }
+
+    bool contains(int i, double px, double py) const {
+        if(half_h[i] < 0) return false;
+        double u = px - cx[i], v = py - cy[i];
+        return qa[i] * u * u + qb[i] * u * v + qc[i] * v * v <= 1.0;
+    }
+};
+
+// ==============================================================================
+// SPAN RASTERIZER
+// ==============================================================================
+// Calls fill(row, first, last) for every run of cells in an nx x ny raster
+// (origin x0, y0) whose centres lie inside crown i. Span ends come from the
+// chord and are then moved by at most a cell so that they agree exactly with
+// contains(), keeping results identical to a per-cell test.
+
+template <class Crowns, class Fill>
+inline void rasterizeCrown(const Crowns& crowns, int i, double x0, double y0,
+                           int nx, int ny, double res, Fill& fill) {
+    CrownBox box;
+    if(!crowns.bounds(i, box)) return;
+    int r_min = std::max(0, (int)floor((box.y_lo - y0) / res));
+    int r_max = std::min(ny - 1, (int)ceil((box.y_hi - y0) / res));
+
+    for(int yi = r_min; yi <= r_max; yi++) {
+        double py = y0 + (yi + 0.5) * res;
+        double x_lo, x_hi;
+        if(!crowns.chord(i, py, x_lo, x_hi)) continue;
+
+        int first = (int)ceil((x_lo - x0) / res - 0.5);
+        int last = (int)floor((x_hi - x0) / res - 0.5);
+        first = std::max(first, -1);
+        last = std::min(last, nx);
+        if(first > last + 1) continue;
+        if(first > -1 && crowns.contains(i, x0 + (first - 0.5) * res, py)) first--;
+        else if(first <= last && !crowns.contains(i, x0 + (first + 0.5) * res, py)) first++;
+        if(last < nx && crowns.contains(i, x0 + (last + 1.5) * res, py)) last++;
+        else if(last >= first && !crowns.contains(i, x0 + (last + 0.5) * res, py)) last--;
+
+        first = std::max(first, 0);
+        last = std::min(last, nx - 1);
+        if(first <= last) fill(yi, first, last);
+    }
+}
+
+// Per-cell crown counts on an nx x ny raster
+struct CountFill {
+    std::vector<int>& count;
+    int nx;
+    void operator()(int row, int first, int last) {
+        int* p = &count[(size_t)row * nx];
+        for(int xi = first; xi <= last; xi++) p[xi]++;
+    }
+};
+
+// Per-cell covered flags on an nx x ny raster
+struct CoverFill {
+    std::vector<char>& covered;
+    int nx;
+    void operator()(int row, int first, int last) {
+        std::fill(covered.begin() + (size_t)row * nx + first,
+                  covered.begin() + (size_t)row * nx + last + 1, (char)1);
+    }
+};
+
+// ==============================================================================
+// CANOPY COVER KERNEL
+// ==============================================================================
+// Proportion of grid cells (cell size grid_res) on a plot_size x plot_size plot
+// whose centre lies inside at least one crown. Same rule as
+// calc_canopy_cover(); shared by calcCanopyCoverCpp and the per-plot target
+// extraction so simulated and observed cover are measured identically.
+// Uses only plain arrays, so it is safe to call from OpenMP threads.
+
+template <class Crowns>
+inline double crownCoverFraction(const Crowns& crowns, double plot_size,
+                                 double grid_res) {
+    int n_cells = (int)ceil(plot_size / grid_res);
+    std::vector<char> covered((size_t)n_cells * n_cells, 0);
+    CoverFill fill = {covered, n_cells};
+    for(int i = 0; i < crowns.size(); i++) {
+        rasterizeCrown(crowns, i, 0.0, 0.0, n_cells, n_cells, grid_res, fill);
+    }
+    long n_covered = std::count(covered.begin(), covered.end(), (char)1);
+    return (double)n_covered / ((double)n_cells * n_cells);
+}
+
+inline double canopyCoverFraction(const double* x, const double* y,
+                                  const double* crown_radius, int n_trees,
+                                  double plot_size, double grid_res) {
+    return crownCoverFraction(CircleCrowns(x, y, crown_radius, n_trees),
+                              plot_size, grid_res);
+}
+
+// ==============================================================================
+// RASTER CROWN OVERLAP
+// ==============================================================================
+// Summed pairwise overlap area, approximated on a raster over the crowns'
+// bounding box: a cell covered by k crowns contributes k (k - 1) / 2 cell
+// areas. Agrees with the exact lens formula of calcCrownOverlapCpp to within
+// the raster resolution, and works for any crown shape. The box is counted
+// in OVERLAP_TILE x OVERLAP_TILE cell tiles, each holding only the crowns
+// whose bounding box reaches it, so memory follows the tile and the crowns
+// rather than the extent of the stand.
+
+const int OVERLAP_TILE = 256;
+
+template <class Crowns>
+inline double crownOverlapArea(const Crowns& crowns, double grid_res) {
+    double x_lo = HUGE_VAL, x_hi = -HUGE_VAL, y_lo = HUGE_VAL, y_hi = -HUGE_VAL;
+    for(int i = 0; i < crowns.size(); i++) {
+        CrownBox box;
+        if(!crowns.bounds(i, box)) continue;
+        x_lo = std::min(x_lo, box.x_lo);
+        x_hi = std::max(x_hi, box.x_hi);
+        y_lo = std::min(y_lo, box.y_lo);
+        y_hi = std::max(y_hi, box.y_hi);
+    }
+    if(!(x_hi > x_lo && y_hi > y_lo)) return 0.0;
+
+    int nx = (int)ceil((x_hi - x_lo) / grid_res) + 1;
+    int ny = (int)ceil((y_hi - y_lo) / grid_res) + 1;
+    int tx = (nx + OVERLAP_TILE - 1) / OVERLAP_TILE;
+    int ty = (ny + OVERLAP_TILE - 1) / OVERLAP_TILE;
+
+    // Crowns per tile, from the cells their bounding box spans
+    std::vector<std::vector<int> > tile_crowns((size_t)tx * ty);
+    for(int i = 0; i < crowns.size(); i++) {
+        CrownBox box;
+        if(!crowns.bounds(i, box)) continue;
+        int c0 = std::max(0, (int)floor((box.x_lo - x_lo) / grid_res) - 1) / OVERLAP_TILE;
+        int c1 = std::min(nx - 1, (int)ceil((box.x_hi - x_lo) / grid_res) + 1) / OVERLAP_TILE;
+        int r0 = std::max(0, (int)floor((box.y_lo - y_lo) / grid_res) - 1) / OVERLAP_TILE;
+        int r1 = std::min(ny - 1, (int)ceil((box.y_hi - y_lo) / grid_res) + 1) / OVERLAP_TILE;
+        for(int r = r0; r <= r1; r++) {
+            for(int c = c0; c <= c1; c++) tile_crowns[(size_t)r * tx + c].push_back(i);
+        }
+    }
+
+    std::vector<int> count;
+    double pairs = 0.0;
+    for(int r = 0; r < ty; r++) {
+        for(int c = 0; c < tx; c++) {
+            const std::vector<int>& members = tile_crowns[(size_t)r * tx + c];
+            if(members.size() < 2) continue;
+            int w = std::min(OVERLAP_TILE, nx - c * OVERLAP_TILE);
+            int h = std::min(OVERLAP_TILE, ny - r * OVERLAP_TILE);
+            double x0 = x_lo + c * OVERLAP_TILE * grid_res;
+            double y0 = y_lo + r * OVERLAP_TILE * grid_res;
+            count.assign((size_t)w * h, 0);
+            CountFill fill = {count, w};
+            for(size_t m = 0; m < members.size(); m++) {
+                rasterizeCrown(crowns, members[m], x0, y0, w, h, grid_res, fill);
+            }
+            for(size_t k = 0; k < count.size(); k++) {
+                if(count[k] > 1) pairs += 0.5 * count[k] * (count[k] - 1);
+            }
+        }
+    }
+    return pairs * grid_res * grid_res;
+}
+
+// ==============================================================================
+// INCREMENTAL COVER RASTER
+// ==============================================================================
+// Same cells and inclusion rule as canopyCoverFraction (circles only), but
+// each cell counts the crowns covering it, so a crown can be added, removed
+// or resized without re-rasterizing the stand. Resizing only visits the ring
+// between the old and new radius: per raster row the cells strictly inside
+// the smaller disc are skipped as one span. A radius < 0 means "no crown".
+
+class CoverRaster {
+public:
+    CoverRaster(double plot_size, double grid_res)
+        : res_(grid_res), n_cells_((int)ceil(plot_size / grid_res)), covered_(0),
+          count_((size_t)n_cells_ * n_cells_, 0) {}
+
+    void add(double x, double y, double r) { resize(x, y, -1.0, r); }
+    void remove(double x, double y, double r) { resize(x, y, r, -1.0); }
+
+    void resize(double x, double y, double r_from, double r_to) {
+        if(r_from == r_to) return;
+        double lo = std::min(r_from, r_to), hi = std::max(r_from, r_to);
+        if(hi < 0) return;
+        int delta = r_to > r_from ? 1 : -1;
+        double hi_sq = hi * hi, lo_sq = lo >= 0 ? lo * lo : -1.0;
+
+        int x_min = std::max(0, (int)floor((x - hi) / res_));
+        int x_max = std::min(n_cells_ - 1, (int)ceil((x + hi) / res_));
+        int y_min = std::max(0, (int)floor((y - hi) / res_));
+        int y_max = std::min(n_cells_ - 1, (int)ceil((y + hi) / res_));
+
+        for(int yi = y_min; yi <= y_max; yi++) {
+            double dy = (yi + 0.5) * res_ - y;
+            double dy_sq = dy * dy;
+            if(dy_sq > hi_sq) continue;
+
+            // Columns certainly inside the smaller disc (margin of one cell)
+            int skip_lo = x_max + 1, skip_hi = x_max;
+            if(lo_sq > dy_sq) {
+                double w = sqrt(lo_sq - dy_sq) - res_;
+                if(w > 0) {
+                    skip_lo = std::max(x_min, (int)ceil((x - w) / res_ - 0.5));
+                    skip_hi = std::min(x_max, (int)floor((x + w) / res_ - 0.5));
+                }
+            }
+
+            int* row = &count_[(size_t)yi * n_cells_];
+            for(int xi = x_min; xi <= x_max; xi++) {
+                if(xi == skip_lo && skip_hi >= skip_lo) {
+                    xi = skip_hi;
+                    continue;
+                }
+                double dx = (xi + 0.5) * res_ - x;
+                double d_sq = dx * dx + dy_sq;
+                if(d_sq <= hi_sq && !(d_sq <= lo_sq)) {
+                    int before = row[xi];
+                    row[xi] += delta;
+                    if(before == 0) covered_++;
+                    else if(row[xi] == 0) covered_--;
+                }
+            }
+        }
+    }
+
+    double fraction() const {
+        return (double)covered_ / ((double)n_cells_ * n_cells_);
+    }
+
+    // Bytes reserved by the counts (memory use)
+    size_t bytes() const { return count_.capacity() * sizeof(int); }
+
+private:
+    double res_;
+    int n_cells_;
+    long covered_;
+    std::vector<int> count_;
+};
+
+// ==============================================================================
+// CROWN STENCIL CACHE
+// ==============================================================================
+// Crown radii from the allometry cluster in a narrow range, so most crowns of
+// a stand share a handful of footprints. A stencil is the footprint of a disc
+// as one column span per raster row, relative to the cell holding the crown
+// centre; it is keyed by the radius quantized to radius_step and the centre's
+// position inside its cell quantized to 1/offsets of a cell. Placing a crown
+// is then a hash lookup plus span writes. The footprint is exact for the
+// quantized crown (radius within radius_step / 2, centre within half an
+// offset step), so cover differs from canopyCoverFraction only at crown edges.
+
+struct CrownStencil {
+    int row0;                    // first row relative to the centre cell
+    std::vector<int> first;      // per row: first and last column relative to
+    std::vector<int> last;       // the centre cell (first > last: empty row)
+};
+
+class StencilCache {
+public:
+    StencilCache(double grid_res, double radius_step = 0.01, int offsets = 8)
+        : res_(grid_res), step_(radius_step), offsets_(std::max(1, std::min(offsets, 256))) {}
+
+    // Stencil of the crown at (x, y) with radius r (>= 0), and its centre cell
+    const CrownStencil& get(double x, double y, double r, int& cell_x, int& cell_y) {
+        double gx = x / res_, gy = y / res_;
+        cell_x = (int)floor(gx);
+        cell_y = (int)floor(gy);
+        int qx = std::min(offsets_ - 1, (int)((gx - cell_x) * offsets_));
+        int qy = std::min(offsets_ - 1, (int)((gy - cell_y) * offsets_));
+        uint64_t rq = (uint64_t)llround(r / step_);
+        uint64_t key = (rq << 16) | ((uint64_t)qx << 8) | (uint64_t)qy;
+
+        std::unordered_map<uint64_t, CrownStencil>::iterator it = cache_.find(key);
+        if(it != cache_.end()) return it->second;
+        return cache_[key] = build(rq * step_, (qx + 0.5) / offsets_, (qy + 0.5) / offsets_);
+    }
+
+    size_t size() const { return cache_.size(); }
+
+private:
+    double res_, step_;
+    int offsets_;
+    std::unordered_map<uint64_t, CrownStencil> cache_;
+
+    struct SpanFill {
+        CrownStencil& s;
+        int k;
+        void operator()(int row, int first, int last) {
+            s.first[row] = first - k;
+            s.last[row] = last - k;
+        }
+    };
+
+    // Rasterize the quantized disc on a window of cells [-k, k] around the
+    // centre cell, with the centre at fractional cell position (fx, fy)
+    CrownStencil build(double r, double fx, double fy) const {
+        int k = (int)ceil(r / res_) + 2;
+        int w = 2 * k + 1;
+        CrownStencil s;
+        s.row0 = -k;
+        s.first.assign(w, 1);
+        s.last.assign(w, 0);
+        double cx = fx * res_, cy = fy * res_;
+        CircleCrowns crown(&cx, &cy, &r, 1);
+        SpanFill fill = {s, k};
+        rasterizeCrown(crown, 0, -k * res_, -k * res_, w, w, res_, fill);
+
+        // Trim empty rows at both ends
+        int lo = 0, hi = w - 1;
+        while(lo <= hi && s.first[lo] > s.last[lo]) lo++;
+        while(hi >= lo && s.first[hi] > s.last[hi]) hi--;
+        s.row0 += lo;
+        s.first.assign(s.first.begin() + lo, s.first.begin() + hi + 1);
+        s.last.assign(s.last.begin() + lo, s.last.begin() + hi + 1);
+        return s;
+    }
+};
+
+// Cell-count cover raster that places crowns through a StencilCache; same
+// interface as CoverRaster. Adding or removing a crown writes its stencil's
+// spans with no distance tests, which pays off where crowns move often (the
+// annealer's cover term); a resize writes only the span ends that differ
+// between the old and new stencil, as CoverRaster walks only the ring.
+class StencilCoverRaster {
+public:
+    StencilCoverRaster(double plot_size, double grid_res, double radius_step = 0.01,
+                       int offsets = 8)
+        : n_cells_((int)ceil(plot_size / grid_res)), covered_(0),
+          count_((size_t)n_cells_ * n_cells_, 0),
+          stencils_(grid_res, radius_step, offsets) {}
+
+    void add(double x, double y, double r) { place(x, y, r, 1); }
+    void remove(double x, double y, double r) { place(x, y, r, -1); }
+    // Same centre, so both stencils share the centre cell: per row only the
+    // cells between the old and the new span ends change
+    void resize(double x, double y, double r_from, double r_to) {
+        if(r_from == r_to) return;
+        if(!(r_from >= 0) || !(r_to >= 0)) {
+            place(x, y, r_from, -1);
+            place(x, y, r_to, 1);
+            return;
+        }
+        int cx, cy;
+        const CrownStencil& a = stencils_.get(x, y, r_from, cx, cy);
+        const CrownStencil& b = stencils_.get(x, y, r_to, cx, cy);
+        if(&a == &b) return;
+        int row_lo = std::min(a.row0, b.row0);
+        int row_hi = std::max(a.row0 + (int)a.first.size(), b.row0 + (int)b.first.size());
+        for(int k = row_lo; k < row_hi; k++) {
+            int yi = cy + k;
+            if(yi < 0 || yi >= n_cells_) continue;
+            int fa = 1, la = 0, fb = 1, lb = 0;
+            if(k >= a.row0 && k < a.row0 + (int)a.first.size()) {
+                fa = a.first[k - a.row0];
+                la = a.last[k - a.row0];
+            }
+            if(k >= b.row0 && k < b.row0 + (int)b.first.size()) {
+                fb = b.first[k - b.row0];
+                lb = b.last[k - b.row0];
+            }
+            if(fa > la || fb > lb || lb < fa || la < fb) {
+                span(yi, cx + fa, cx + la, -1);
+                span(yi, cx + fb, cx + lb, 1);
+                continue;
+            }
+            if(fb < fa) span(yi, cx + fb, cx + fa - 1, 1);
+            else span(yi, cx + fa, cx + fb - 1, -1);
+            if(lb > la) span(yi, cx + la + 1, cx + lb, 1);
+            else span(yi, cx + lb + 1, cx + la, -1);
+        }
+    }
+
+    double fraction() const {
+        return (double)covered_ / ((double)n_cells_ * n_cells_);
+    }
+
+    size_t stencils() const { return stencils_.size(); }
+
+private:
+    int n_cells_;
+    long covered_;
+    std::vector<int> count_;
+    StencilCache stencils_;
+
+    void place(double x, double y, double r, int delta) {
+        if(!(r >= 0)) return;
+        int cx, cy;
+        const CrownStencil& s = stencils_.get(x, y, r, cx, cy);
+        int n_rows = (int)s.first.size();
+        for(int k = 0; k < n_rows; k++) {
+            int yi = cy + s.row0 + k;
+            if(yi < 0 || yi >= n_cells_) continue;
+            span(yi, cx + s.first[k], cx + s.last[k], delta);
+        }
+    }
+
+    // Add delta to the cells first..last of row yi (clipped to the plot)
+    void span(int yi, int first, int last, int delta) {
+        first = std::max(0, first);
+        last = std::min(n_cells_ - 1, last);
+        int* row = &count_[(size_t)yi * n_cells_];
+        for(int xi = first; xi <= last; xi++) {
+            int before = row[xi];
+            row[xi] += delta;
+            if(before == 0) covered_++;
+            else if(row[xi] == 0) covered_--;
+        }
+    }
+};
+
+// ==============================================================================
+// INTERVAL COVER
+// ==============================================================================
+// Sparse alternative to the cell rasters for large or low-cover plots: each
+// raster row (centre line y = (j + 0.5) * row_res) keeps the sorted list of
+// crown chords crossing it, clipped to [0, plot_size], and caches the length
+// of their union. Cover is the summed union length over rows, so it is exact
+// in x and sampled at row_res in y. Memory grows with the number of chords
+// (crowns times their height in rows), not with the raster area, and an
+// add/remove touches only the crown's own rows. Offers the same add, remove,
+// resize and fraction() interface as CoverRaster for circular crowns.
+
+class IntervalCover {
+public:
+    IntervalCover(double plot_size, double row_res)
+        : res_(row_res), plot_size_(plot_size),
+          n_rows_((int)ceil(plot_size / row_res)), covered_(0.0),
+          chords_(n_rows_), length_(n_rows_, 0.0) {}
+
+    void add(double x, double y, double r) {
+        update(CircleCrowns(&x, &y, &r, 1), 0, 1);
+    }
+    void remove(double x, double y, double r) {
+        update(CircleCrowns(&x, &y, &r, 1), 0, -1);
+    }
+    void resize(double x, double y, double r_from, double r_to) {
+        if(r_from == r_to) return;
+        if(r_from >= 0) remove(x, y, r_from);
+        if(r_to >= 0) add(x, y, r_to);
+    }
+
+    // Insert (sign 1) or remove (sign -1) crown i of any crown shape. A
+    // removal must repeat the exact arguments of the matching insert.
+    template <class Crowns>
+    void update(const Crowns& crowns, int i, int sign) {
+        int first, last;
+        if(!rows(crowns, i, first, last)) return;
+        for(int j = first; j <= last; j++) {
+            Chord c;
+            if(!chord(crowns, i, j, c)) continue;
+            std::vector<Chord>& row = chords_[j];
+            std::vector<Chord>::iterator it = std::lower_bound(row.begin(), row.end(), c);
+            if(sign > 0) {
+                row.insert(it, c);
+            } else if(it != row.end() && *it == c) {
+                row.erase(it);
+            } else {
+                continue;
+            }
+            refresh(j);
+        }
+    }
+
+    // Insert many crowns at once: chords are appended and each row sorted
+    // once, instead of one sorted insert per chord
+    template <class Crowns>
+    void addAll(const Crowns& crowns) {
+        std::vector<char> dirty(n_rows_, 0);
+        for(int i = 0; i < crowns.size(); i++) {
+            int first, last;
+            if(!rows(crowns, i, first, last)) continue;
+            for(int j = first; j <= last; j++) {
+                Chord c;
+                if(!chord(crowns, i, j, c)) continue;
+                chords_[j].push_back(c);
+                dirty[j] = 1;
+            }
+        }
+        for(int j = 0; j < n_rows_; j++) {
+            if(!dirty[j]) continue;
+            std::sort(chords_[j].begin(), chords_[j].end());
+            refresh(j);
+        }
+    }
+
+    double fraction() const {
+        if(n_rows_ == 0) return 0.0;
+        return std::max(covered_, 0.0) / ((double)n_rows_ * plot_size_);
+    }
+
+    // Number of stored chords (memory use)
+    size_t chords() const {
+        size_t k = 0;
+        for(int j = 0; j < n_rows_; j++) k += chords_[j].size();
+        return k;
+    }
+
+    // Bytes reserved by the rows and their chords (memory use)
+    size_t bytes() const {
+        size_t b = chords_.capacity() * sizeof(std::vector<Chord>) +
+                   length_.capacity() * sizeof(double);
+        for(int j = 0; j < n_rows_; j++) b += chords_[j].capacity() * sizeof(Chord);
+        return b;
+    }
+
+private:
+    struct Chord {
+        double lo, hi;
+        bool operator<(const Chord& o) const {
+            return lo < o.lo || (lo == o.lo && hi < o.hi);
+        }
+        bool operator==(const Chord& o) const { return lo == o.lo && hi == o.hi; }
+    };
+
+    double res_, plot_size_;
+    int n_rows_;
+    double covered_;
+    std::vector<std::vector<Chord> > chords_;
+    std::vector<double> length_;
+
+    template <class Crowns>
+    bool rows(const Crowns& crowns, int i, int& first, int& last) const {
+        CrownBox box;
+        if(!crowns.bounds(i, box)) return false;
+        first = std::max(0, (int)ceil(box.y_lo / res_ - 0.5));
+        last = std::min(n_rows_ - 1, (int)floor(box.y_hi / res_ - 0.5));
+        return first <= last;
+    }
+
+    template <class Crowns>
+    bool chord(const Crowns& crowns, int i, int j, Chord& c) const {
+        if(!crowns.chord(i, (j + 0.5) * res_, c.lo, c.hi)) return false;
+        c.lo = std::max(c.lo, 0.0);
+        c.hi = std::min(c.hi, plot_size_);
+        return c.hi > c.lo;
+    }
+
+    // Recompute the union length of row j from its sorted chords
+    void refresh(int j) {
+        const std::vector<Chord>& row = chords_[j];
+        double len = 0.0, cur_lo = 0.0, cur_hi = -1.0;
+        for(size_t k = 0; k < row.size(); k++) {
+            if(row[k].lo > cur_hi) {
+                if(cur_hi > cur_lo) len += cur_hi - cur_lo;
+                cur_lo = row[k].lo;
+                cur_hi = row[k].hi;
+            } else if(row[k].hi > cur_hi) {
+                cur_hi = row[k].hi;
+            }
+        }
+        if(cur_hi > cur_lo) len += cur_hi - cur_lo;
+        covered_ += len - length_[j];
+        length_[j] = len;
+    }
+};
+
+// One-shot cover of a set of crowns with the interval representation
+template <class Crowns>
+inline double intervalCoverFraction(const Crowns& crowns, double plot_size,
+                                    double row_res) {
+    IntervalCover cover(plot_size, row_res);
+    cover.addAll(crowns);
+    return cover.fraction();
+}
+
+#endif
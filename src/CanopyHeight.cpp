@@ -0,0 +1,58 @@
+#include <Rcpp.h>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "CanopyHeight.h"
+
+using namespace Rcpp;
+using namespace std;
+
+// ==============================================================================
+// CANOPY HEIGHT MODEL
+// ==============================================================================
+// CHM raster of a stand (see CanopyHeight.h), for comparison with lidar.
+// With top_k = 0 the raster is the one-shot per-cell maximum; with top_k > 0
+// it is built by adding every crown to a CanopyHeightRaster and then
+// removing the trees in `drop` (1-based), as the annealer's chm term does
+// with moved trees. Both give the same raster for the trees that remain.
+
+// [[Rcpp::export]]
+List calcCanopyHeightCpp(NumericVector x, NumericVector y, NumericVector crown_radius,
+                         NumericVector height, NumericVector crown_base,
+                         double plot_size = 100.0, double grid_res = 0.5,
+                         int profile = 1, int top_k = 0,
+                         IntegerVector drop = IntegerVector(0),
+                         NumericVector probs = NumericVector(0),
+                         double min_height = 0.0, double height_res = 0.1) {
+    int n = x.size();
+    if(profile < PROFILE_FLAT || profile > PROFILE_ELLIPSOID) stop("unknown crown profile %d", profile);
+    int n_cells = (int)ceil(plot_size / grid_res);
+    NumericMatrix chm(n_cells, n_cells);
+    NumericVector pct(probs.size(), NA_REAL);
+
+    if(top_k <= 0) {
+        vector<double> cells;
+        canopyHeightModel(x.begin(), y.begin(), crown_radius.begin(), height.begin(),
+                          crown_base.begin(), n, plot_size, grid_res, profile, cells);
+        for(int yi = 0; yi < n_cells; yi++) {
+            for(int xi = 0; xi < n_cells; xi++) chm(xi, yi) = cells[(size_t)yi * n_cells + xi];
+        }
+        return List::create(Named("chm") = chm,
+                            Named("percentiles") = pct,
+                            Named("rescans") = 0);
+    }
+
+    CanopyHeightRaster raster(plot_size, grid_res, profile, top_k, height_res);
+    for(int i = 0; i < n; i++) {
+        raster.add(i, x[i], y[i], crown_radius[i], height[i], crown_base[i]);
+    }
+    for(int k = 0; k < drop.size(); k++) raster.remove(drop[k] - 1);
+    for(int yi = 0; yi < n_cells; yi++) {
+        for(int xi = 0; xi < n_cells; xi++) chm(xi, yi) = raster.value(xi, yi);
+    }
+    for(int k = 0; k < probs.size(); k++) pct[k] = raster.percentile(probs[k], min_height);
+
+    return List::create(Named("chm") = chm,
+                        Named("percentiles") = pct,
+                        Named("rescans") = (double)raster.rescans());
+}
@@ -0,0 +1,315 @@
+#ifndef EMPIRICALPATTERNR_CANOPYHEIGHT_H
+#define EMPIRICALPATTERNR_CANOPYHEIGHT_H
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "CanopyCover.h"
+
+// ==============================================================================
+// CROWN SURFACE PROFILES
+// ==============================================================================
+// A canopy height model (CHM) holds, per raster cell, the height of the
+// highest crown surface above the cell centre (0 where no crown covers it).
+// Crowns are circles of crown_radius around the stem; the surface over a
+// point at horizontal distance d from the stem depends on the profile:
+//
+//   flat       tree height everywhere
+//   cone       tree height at the stem, falling linearly to the crown base
+//              at the crown edge
+//   ellipsoid  upper half of an ellipsoid spanning crown base to tree height:
+//              tree height at the stem, mid-crown height at the edge
+//
+// Cells are those of the cover raster (centres at (i + 0.5) * grid_res), with
+// the same inclusion rule, so a cell has a CHM value exactly when it counts
+// as covered.
+
+enum CrownProfile { PROFILE_FLAT = 0, PROFILE_CONE = 1, PROFILE_ELLIPSOID = 2 };
+
+inline double crownSurface(int profile, double d, double r, double height, double base) {
+    if(profile == PROFILE_FLAT || !(r > 0)) return height;
+    double t = std::min(d / r, 1.0);
+    if(profile == PROFILE_CONE) return height - (height - base) * t;
+    double semi = 0.5 * (height - base);
+    return base + semi + semi * sqrt(std::max(0.0, 1.0 - t * t));
+}
+
+// One-shot CHM: per-cell maximum of the crown surfaces, one span per crown
+// row. chm is nx x nx, row-major by y (cell (xi, yi) at yi * nx + xi).
+struct SurfaceMaxFill {
+    std::vector<double>& chm;
+    int nx, profile;
+    double res, x, y, r, height, base;
+    void operator()(int row, int first, int last) {
+        double dy = (row + 0.5) * res - y;
+        double* p = &chm[(size_t)row * nx];
+        for(int xi = first; xi <= last; xi++) {
+            double dx = (xi + 0.5) * res - x;
+            double h = crownSurface(profile, sqrt(dx * dx + dy * dy), r, height, base);
+            if(h > p[xi]) p[xi] = h;
+        }
+    }
+};
+
+inline void canopyHeightModel(const double* x, const double* y, const double* crown_radius,
+                              const double* height, const double* crown_base, int n_trees,
+                              double plot_size, double grid_res, int profile,
+                              std::vector<double>& chm) {
+    int n_cells = (int)ceil(plot_size / grid_res);
+    chm.assign((size_t)n_cells * n_cells, 0.0);
+    CircleCrowns crowns(x, y, crown_radius, n_trees);
+    SurfaceMaxFill fill = {chm, n_cells, profile, grid_res, 0, 0, 0, 0, 0};
+    for(int i = 0; i < n_trees; i++) {
+        fill.x = x[i];
+        fill.y = y[i];
+        fill.r = crown_radius[i];
+        fill.height = height[i];
+        fill.base = crown_base[i];
+        rasterizeCrown(crowns, i, 0.0, 0.0, n_cells, n_cells, grid_res, fill);
+    }
+}
+
+// ==============================================================================
+// INCREMENTAL CANOPY HEIGHT RASTER
+// ==============================================================================
+// A maximum cannot be updated when a crown is removed, so each cell keeps the
+// number of crowns covering it and a short list of the top_k highest crown
+// surfaces over it (height and tree). The list always holds the true highest
+// m crowns of the cell for some m <= top_k:
+//
+//   add     the new surface enters the list if it is full and higher than
+//           its last entry, or if the list is not full and either holds all
+//           crowns of the cell or the new surface is at least its last entry
+//   remove  the tree leaves the list if it is there
+//
+// The cell's CHM value is the head of the list. Only when a removal empties
+// the list of a cell that is still covered is the cell rebuilt (rescan) from
+// the crowns listed in its block of BLOCK x BLOCK cells, each crown being
+// listed in every block its bounding box touches; with a few entries per cell
+// that is rare, since it takes top_k removals of the highest crowns above one
+// cell without any higher crown arriving.
+//
+// Heights of covered cells are also counted in height_res classes, so CHM
+// percentiles cost O(classes) per query; they interpolate linearly within a
+// class and so are resolved to about height_res.
+
+class CanopyHeightRaster {
+public:
+    CanopyHeightRaster(double plot_size, double grid_res, int profile, int top_k = 4,
+                       double height_res = 0.1)
+        : res_(grid_res), n_cells_((int)ceil(plot_size / grid_res)), profile_(profile),
+          top_k_(std::max(1, top_k)), height_res_(height_res), n_canopy_(0), rescans_(0),
+          count_((size_t)n_cells_ * n_cells_, 0), top_n_((size_t)n_cells_ * n_cells_, 0),
+          top_((size_t)n_cells_ * n_cells_ * std::max(1, top_k)),
+          n_blocks_((n_cells_ + BLOCK - 1) / BLOCK),
+          blocks_((size_t)n_blocks_ * n_blocks_) {}
+
+    // Place tree i (any id >= 0; ids are reused across add / remove)
+    void add(int i, double x, double y, double r, double height, double base) {
+        if(i >= (int)crowns_.size()) crowns_.resize(i + 1);
+        Crown c = {x, y, r, height, base, true};
+        crowns_[i] = c;
+        list(c, i, true);
+        Visit v = {*this, i, true, 0, 0, 0, 0, 0};
+        rasterize(c, v);
+    }
+
+    void remove(int i) {
+        if(i < 0 || i >= (int)crowns_.size() || !crowns_[i].active) return;
+        Crown c = crowns_[i];
+        crowns_[i].active = false;
+        list(c, i, false);
+        Visit v = {*this, i, false, 0, 0, 0, 0, 0};
+        rasterize(c, v);
+    }
+
+    // CHM value of cell (xi, yi), 0 if uncovered
+    double value(int xi, int yi) const { return value((size_t)yi * n_cells_ + xi); }
+
+    int cells() const { return n_cells_; }
+    long canopyCells() const { return n_canopy_; }
+    long rescans() const { return rescans_; }
+
+    // Height below which a fraction p of the covered cells with CHM >=
+    // min_height lie; 0 without such cells
+    double percentile(double p, double min_height = 0.0) const {
+        int b0 = std::max(0, (int)floor(min_height / height_res_));
+        long n = 0;
+        for(size_t b = b0; b < hist_.size(); b++) n += hist_[b];
+        if(n == 0) return 0.0;
+        double rank = std::min(std::max(p, 0.0), 1.0) * n, cum = 0.0;
+        for(size_t b = b0; b < hist_.size(); b++) {
+            if(hist_[b] > 0 && cum + hist_[b] >= rank) {
+                return (b + (rank - cum) / hist_[b]) * height_res_;
+            }
+            cum += hist_[b];
+        }
+        return hist_.size() * height_res_;
+    }
+
+private:
+    struct Crown {
+        double x, y, r, height, base;
+        bool active;
+    };
+    struct Entry {
+        double h;
+        int tree;
+    };
+
+    static const int BLOCK = 8;
+
+    double res_;
+    int n_cells_, profile_, top_k_;
+    double height_res_;
+    long n_canopy_, rescans_;
+    std::vector<int> count_, top_n_;
+    std::vector<Entry> top_;           // top_k_ entries per cell, highest first
+    std::vector<long> hist_;           // covered cells per height class
+    std::vector<Crown> crowns_;
+    int n_blocks_;
+    std::vector<std::vector<int> > blocks_;   // crowns touching each block
+
+    // Applies an add or a remove of one tree to each cell of its crown
+    struct Visit {
+        CanopyHeightRaster& raster;
+        int tree;
+        bool add;
+        double x, y, r, height, base;
+        void operator()(int row, int first, int last) {
+            double dy = (row + 0.5) * raster.res_ - y;
+            for(int xi = first; xi <= last; xi++) {
+                size_t c = (size_t)row * raster.n_cells_ + xi;
+                if(add) {
+                    double dx = (xi + 0.5) * raster.res_ - x;
+                    raster.insert(c, crownSurface(raster.profile_, sqrt(dx * dx + dy * dy),
+                                                  r, height, base), tree);
+                } else {
+                    raster.erase(c, tree);
+                }
+            }
+        }
+    };
+
+    void rasterize(const Crown& c, Visit& v) {
+        v.x = c.x;
+        v.y = c.y;
+        v.r = c.r;
+        v.height = c.height;
+        v.base = c.base;
+        CircleCrowns crown(&c.x, &c.y, &c.r, 1);
+        rasterizeCrown(crown, 0, 0.0, 0.0, n_cells_, n_cells_, res_, v);
+    }
+
+    // Add tree i to (or drop it from) the blocks its crown's box touches
+    void list(const Crown& c, int i, bool add) {
+        if(!(c.r >= 0)) return;
+        double span = res_ * BLOCK;
+        int b_x0 = std::max(0, (int)floor((c.x - c.r) / span));
+        int b_x1 = std::min(n_blocks_ - 1, (int)floor((c.x + c.r) / span));
+        int b_y0 = std::max(0, (int)floor((c.y - c.r) / span));
+        int b_y1 = std::min(n_blocks_ - 1, (int)floor((c.y + c.r) / span));
+        for(int by = b_y0; by <= b_y1; by++) {
+            for(int bx = b_x0; bx <= b_x1; bx++) {
+                std::vector<int>& b = blocks_[(size_t)by * n_blocks_ + bx];
+                if(add) {
+                    b.push_back(i);
+                    continue;
+                }
+                std::vector<int>::iterator it = std::find(b.begin(), b.end(), i);
+                if(it == b.end()) continue;
+                *it = b.back();
+                b.pop_back();
+            }
+        }
+    }
+
+    double value(size_t c) const {
+        return top_n_[c] > 0 ? top_[c * top_k_].h : 0.0;
+    }
+
+    int heightClass(double h) const { return std::max(0, (int)(h / height_res_)); }
+
+    // Move cell c in the height classes from (covered before, old value) to
+    // its current state
+    void recount(size_t c, bool was_covered, double old_h) {
+        bool covered = count_[c] > 0;
+        double h = value(c);
+        if(was_covered == covered && old_h == h) return;
+        if(was_covered) {
+            hist_[heightClass(old_h)]--;
+            n_canopy_--;
+        }
+        if(covered) {
+            int b = heightClass(h);
+            if(b >= (int)hist_.size()) hist_.resize(b + 1, 0);
+            hist_[b]++;
+            n_canopy_++;
+        }
+    }
+
+    void insert(size_t c, double h, int tree) {
+        bool was_covered = count_[c] > 0;
+        double old_h = value(c);
+        Entry* e = &top_[c * top_k_];
+        int n = top_n_[c];
+        bool complete = n == count_[c];
+        count_[c]++;
+        if(n == top_k_ ? h > e[n - 1].h : (complete || h >= e[n - 1].h)) {
+            int k = std::min(n, top_k_ - 1);
+            while(k > 0 && e[k - 1].h < h) {
+                e[k] = e[k - 1];
+                k--;
+            }
+            e[k].h = h;
+            e[k].tree = tree;
+            if(n < top_k_) top_n_[c]++;
+        }
+        recount(c, was_covered, old_h);
+    }
+
+    void erase(size_t c, int tree) {
+        double old_h = value(c);
+        Entry* e = &top_[c * top_k_];
+        int n = top_n_[c];
+        count_[c]--;
+        for(int k = 0; k < n; k++) {
+            if(e[k].tree != tree) continue;
+            for(int m = k + 1; m < n; m++) e[m - 1] = e[m];
+            top_n_[c]--;
+            break;
+        }
+        if(top_n_[c] == 0 && count_[c] > 0) rescan(c);
+        recount(c, true, old_h);
+    }
+
+    // Rebuild the list of cell c from the crowns listed in its block
+    void rescan(size_t c) {
+        rescans_++;
+        int xi = (int)(c % n_cells_), yi = (int)(c / n_cells_);
+        double px = (xi + 0.5) * res_, py = (yi + 0.5) * res_;
+        const std::vector<int>& block = blocks_[(size_t)(yi / BLOCK) * n_blocks_ + xi / BLOCK];
+        Entry* e = &top_[c * top_k_];
+        int n = 0;
+        for(size_t m = 0; m < block.size(); m++) {
+            int i = block[m];
+            const Crown& cr = crowns_[i];
+            CircleCrowns crown(&cr.x, &cr.y, &cr.r, 1);
+            if(!crown.contains(0, px, py)) continue;
+            double h = crownSurface(profile_, hypot(px - cr.x, py - cr.y), cr.r,
+                                    cr.height, cr.base);
+            if(n == top_k_ && !(h > e[n - 1].h)) continue;
+            int k = std::min(n, top_k_ - 1);
+            while(k > 0 && e[k - 1].h < h) {
+                e[k] = e[k - 1];
+                k--;
+            }
+            e[k].h = h;
+            e[k].tree = i;
+            if(n < top_k_) n++;
+        }
+        top_n_[c] = n;
+    }
+};
+
+#endif
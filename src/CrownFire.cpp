@@ -0,0 +1,272 @@
+#include <Rcpp.h>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace Rcpp;
+using namespace std;
+
+// ==============================================================================
+// SURFACE FIRE SPREAD (ROTHERMEL 1972)
+// ==============================================================================
+// Spread rate of a surface fire in a static fuel model with three dead size
+// classes (1, 10, 100 h) and one live class, in the English units of the
+// original model (lb, ft, min, BTU). Only the no-wind, no-slope spread rate
+// and the heat per unit area depend on fuel moisture; the wind coefficient
+// C (beta / beta_op)^-E and exponent B depend on the fuel bed alone, so the
+// spread rate at any wind follows in closed form:
+//
+//   R(U) = R0 (1 + phi_s + wind_coef * U^wind_exp),  U midflame wind (ft/min)
+//
+// which is what lets the torching and crowning indices be solved for the
+// wind speed directly. The wind limit is not applied (Andrews et al. 2013).
+
+// Fuel model: loads (lb/ft^2) of the 1 h, 10 h, 100 h and live classes,
+// surface-area-to-volume ratios (1/ft) of the 1 h and live classes, fuel bed
+// depth (ft) and dead moisture of extinction (fraction)
+struct FuelModel {
+    double load[4];
+    double sav[4];
+    double depth, mx_dead;
+};
+
+static const double FUEL_DENSITY = 32.0;         // lb/ft^3
+static const double HEAT_CONTENT = 8000.0;       // BTU/lb
+static const double TOTAL_MINERAL = 0.0555;
+static const double ETA_S = 0.4174;              // 0.174 * 0.01^-0.19 (S_e = 0.01)
+
+struct SurfaceFire {
+    double r0;          // no-wind, no-slope spread rate (ft/min)
+    double hpa;         // heat per unit area (BTU/ft^2)
+    double wind_coef;   // C (beta / beta_op)^-E
+    double wind_exp;    // B
+    double slope_coef;  // 5.275 beta^-0.3: phi_s = slope_coef * tan^2(slope)
+};
+
+static double moistureDamping(double m, double mx) {
+    if(mx <= 0) return 0.0;
+    double r = min(m / mx, 1.0);
+    return 1.0 - 2.59 * r + 5.11 * r * r - 3.52 * r * r * r;
+}
+
+// moisture: fractions for the 1 h, 10 h, 100 h and live classes
+static SurfaceFire rothermel(const FuelModel& fm, const double* moisture) {
+    SurfaceFire out = {0.0, 0.0, 0.0, 1.0, 0.0};
+    double area[4], total_load = 0.0, a_dead = 0.0, a_live = 0.0;
+    for(int k = 0; k < 4; k++) {
+        area[k] = fm.load[k] > 0 ? fm.sav[k] * fm.load[k] / FUEL_DENSITY : 0.0;
+        total_load += fm.load[k];
+        if(k < 3) a_dead += area[k];
+        else a_live += area[k];
+    }
+    if(a_dead + a_live <= 0 || fm.depth <= 0) return out;
+
+    // Weights within and between the dead and live categories
+    double f[4];
+    for(int k = 0; k < 3; k++) f[k] = a_dead > 0 ? area[k] / a_dead : 0.0;
+    f[3] = a_live > 0 ? 1.0 : 0.0;
+    double f_dead = a_dead / (a_dead + a_live), f_live = 1.0 - f_dead;
+
+    double sav_dead = 0.0, wn_dead = 0.0, m_dead = 0.0;
+    for(int k = 0; k < 3; k++) {
+        sav_dead += f[k] * fm.sav[k];
+        wn_dead += f[k] * fm.load[k] * (1.0 - TOTAL_MINERAL);
+        m_dead += f[k] * moisture[k];
+    }
+    double sav_live = fm.sav[3], wn_live = fm.load[3] * (1.0 - TOTAL_MINERAL);
+    double sigma = f_dead * sav_dead + f_live * sav_live;
+
+    // Live moisture of extinction from the fine dead / live load ratio
+    double fine_dead = 0.0, fine_dead_m = 0.0, fine_live = 0.0;
+    for(int k = 0; k < 3; k++) {
+        if(fm.load[k] <= 0) continue;
+        double w = fm.load[k] * exp(-138.0 / fm.sav[k]);
+        fine_dead += w;
+        fine_dead_m += w * moisture[k];
+    }
+    if(fm.load[3] > 0) fine_live = fm.load[3] * exp(-500.0 / fm.sav[3]);
+    double mx_live = fm.mx_dead;
+    if(fine_live > 0 && fine_dead > 0) {
+        mx_live = 2.9 * (fine_dead / fine_live) *
+                  (1.0 - fine_dead_m / fine_dead / fm.mx_dead) - 0.226;
+        mx_live = max(mx_live, fm.mx_dead);
+    }
+
+    double beta = total_load / fm.depth / FUEL_DENSITY;
+    double beta_op = 3.348 * pow(sigma, -0.8189);
+    double ratio = beta / beta_op;
+    double s15 = pow(sigma, 1.5);
+    double gamma_max = s15 / (495.0 + 0.0594 * s15);
+    double a = 133.0 * pow(sigma, -0.7913);
+    double gamma = gamma_max * pow(ratio, a) * exp(a * (1.0 - ratio));
+
+    double ir = gamma * HEAT_CONTENT * ETA_S *
+                (wn_dead * moistureDamping(m_dead, fm.mx_dead) +
+                 wn_live * moistureDamping(moisture[3], mx_live));
+    double xi = exp((0.792 + 0.681 * sqrt(sigma)) * (beta + 0.1)) / (192.0 + 0.2595 * sigma);
+
+    double sink = 0.0;
+    for(int k = 0; k < 4; k++) {
+        if(fm.load[k] <= 0) continue;
+        double w = (k < 3 ? f_dead * f[k] : f_live);
+        sink += w * exp(-138.0 / fm.sav[k]) * (250.0 + 1116.0 * moisture[k]);
+    }
+    sink *= total_load / fm.depth;
+
+    out.r0 = sink > 0 ? ir * xi / sink : 0.0;
+    out.hpa = ir * 384.0 / sigma;
+    out.wind_exp = 0.02526 * pow(sigma, 0.54);
+    out.wind_coef = 7.47 * exp(-0.133 * pow(sigma, 0.55)) *
+                    pow(ratio, -0.715 * exp(-3.59e-4 * sigma));
+    out.slope_coef = 5.275 * pow(beta, -0.3);
+    return out;
+}
+
+static FuelModel fuelModel(NumericVector p) {
+    if(p.size() != 10) stop("fuel model needs 10 parameters");
+    FuelModel fm;
+    for(int k = 0; k < 4; k++) {
+        fm.load[k] = p[k];
+        fm.sav[k] = p[4 + k];
+    }
+    fm.depth = p[8];
+    fm.mx_dead = p[9];
+    return fm;
+}
+
+// ==============================================================================
+// CROWN FIRE HAZARD (SCOTT & REINHARDT 2001)
+// ==============================================================================
+// For every stand (canopy base height, canopy bulk density) and weather
+// scenario:
+//
+//   I0   critical surface fireline intensity for crown ignition (Van Wagner
+//        1977): (0.010 CBH (460 + 25.9 FMC))^1.5 kW/m
+//   R'a  critical spread rate for active crowning: 3.0 / CBD m/min
+//   torching index   20-ft wind (km/h) at which the surface fire reaches I0
+//   crowning index   20-ft wind at which the crown fire spread rate,
+//                    3.34 times that of fuel model 10 at a wind adjustment
+//                    factor of 0.4 (Rothermel 1991), reaches R'a
+//   transition ratio surface fireline intensity / I0 at the scenario wind
+//   active ratio     crown fire spread rate / R'a at the scenario wind
+//   fire type        1 surface, 2 passive crown (torching), 3 active crown,
+//                    4 conditional crown (TR < 1 <= AR)
+//
+// Everything that depends on the scenario alone (surface and FM10 spread,
+// heat per unit area, slope and wind factors) is computed once per scenario.
+// Stands are split into blocks for the threads; within a block each
+// scenario is one pass over the block's stands, which are contiguous in the
+// column-major stand x scenario result matrices, so the pass vectorizes.
+
+static const double FT_MIN_TO_KMH = 0.018288;
+static const double FT_TO_M = 0.3048;
+static const double BTU_FT2_TO_KJ_M2 = 11.3565;
+static const double CROWN_WAF = 0.4;
+static const int FIRE_BLOCK = 256;
+
+// [[Rcpp::plugins(openmp)]]
+// [[Rcpp::export]]
+List crownFireIndicesCpp(NumericVector cbh, NumericVector cbd, NumericVector fuel,
+                         NumericVector fuel10, NumericVector wind, NumericVector fmc,
+                         NumericVector m1, NumericVector m10, NumericVector m100,
+                         NumericVector m_live, NumericVector waf, NumericVector slope,
+                         int n_threads = 0) {
+    int n = cbh.size(), n_sc = wind.size();
+    if(cbd.size() != n) stop("cbh and cbd must have the same length");
+    if(fmc.size() != n_sc || m1.size() != n_sc || m10.size() != n_sc ||
+       m100.size() != n_sc || m_live.size() != n_sc || waf.size() != n_sc ||
+       slope.size() != n_sc) {
+        stop("weather columns must have the same length");
+    }
+    FuelModel fm = fuelModel(fuel), fm10 = fuelModel(fuel10);
+
+    // Per scenario: surface fire (m/min, kJ/m^2), crown fire spread and the
+    // wind speed conversions
+    vector<double> r0(n_sc), hpa(n_sc), phi_s(n_sc), kw(n_sc), inv_b(n_sc), ti_scale(n_sc);
+    vector<double> r0_10(n_sc), phi_s10(n_sc), kw10(n_sc), inv_b10(n_sc);
+    vector<double> surface_ib(n_sc), crown_ros(n_sc), i0_fmc(n_sc);
+    for(int s = 0; s < n_sc; s++) {
+        double moisture[4] = {m1[s] / 100.0, m10[s] / 100.0, m100[s] / 100.0, m_live[s] / 100.0};
+        SurfaceFire sf = rothermel(fm, moisture), sf10 = rothermel(fm10, moisture);
+        double tan_sq = slope[s] / 100.0 * slope[s] / 100.0;
+        double u_mid = wind[s] / FT_MIN_TO_KMH * waf[s];
+        double u_crown = wind[s] / FT_MIN_TO_KMH * CROWN_WAF;
+
+        r0[s] = sf.r0 * FT_TO_M;
+        hpa[s] = sf.hpa * BTU_FT2_TO_KJ_M2;
+        phi_s[s] = sf.slope_coef * tan_sq;
+        kw[s] = sf.wind_coef;
+        inv_b[s] = 1.0 / sf.wind_exp;
+        ti_scale[s] = waf[s] > 0 ? FT_MIN_TO_KMH / waf[s] : HUGE_VAL;
+
+        r0_10[s] = 3.34 * sf10.r0 * FT_TO_M;
+        phi_s10[s] = sf10.slope_coef * tan_sq;
+        kw10[s] = sf10.wind_coef;
+        inv_b10[s] = 1.0 / sf10.wind_exp;
+
+        double ros = r0[s] * (1.0 + phi_s[s] + kw[s] * pow(u_mid, sf.wind_exp));
+        surface_ib[s] = hpa[s] * ros / 60.0;
+        crown_ros[s] = r0_10[s] * (1.0 + phi_s10[s] + kw10[s] * pow(u_crown, sf10.wind_exp));
+        i0_fmc[s] = 0.010 * (460.0 + 25.9 * fmc[s]);
+    }
+
+    NumericMatrix torching(n, n_sc), crowning(n, n_sc), transition(n, n_sc), active(n, n_sc);
+    IntegerMatrix fire_type(n, n_sc);
+    const double* pcbh = cbh.begin();
+    const double* pcbd = cbd.begin();
+    double* pti = torching.begin();
+    double* pci = crowning.begin();
+    double* ptr = transition.begin();
+    double* par = active.begin();
+    int* pft = fire_type.begin();
+    int n_blocks = (n + FIRE_BLOCK - 1) / FIRE_BLOCK;
+
+    #ifdef _OPENMP
+    if(n_threads > 0) {
+        omp_set_num_threads(n_threads);
+    }
+    #pragma omp parallel for schedule(dynamic) if(n_blocks > 1)
+    #endif
+    for(int b = 0; b < n_blocks; b++) {
+        int begin = b * FIRE_BLOCK, end = min(n, begin + FIRE_BLOCK);
+        for(int s = 0; s < n_sc; s++) {
+            size_t col = (size_t)s * n;
+            double r0_s = r0[s], hpa_s = hpa[s], base_s = 1.0 + phi_s[s], kw_s = kw[s];
+            double ib_s = inv_b[s], scale_s = ti_scale[s], i0f_s = i0_fmc[s];
+            double r10_s = r0_10[s], base10_s = 1.0 + phi_s10[s], kw10_s = kw10[s];
+            double ib10_s = inv_b10[s], sib_s = surface_ib[s], cros_s = crown_ros[s];
+
+            #ifdef _OPENMP
+            #pragma omp simd
+            #endif
+            for(int i = begin; i < end; i++) {
+                double i0 = pow(i0f_s * max(pcbh[i], 0.0), 1.5);
+                double need = hpa_s > 0 && r0_s > 0 ? 60.0 * i0 / hpa_s / r0_s - base_s : HUGE_VAL;
+                double ti = need > 0 ? pow(need / kw_s, ib_s) * scale_s : 0.0;
+
+                double ra = pcbd[i] > 0 ? 3.0 / pcbd[i] : HUGE_VAL;
+                double need10 = r10_s > 0 ? ra / r10_s - base10_s : HUGE_VAL;
+                double ci = need10 > 0 ? pow(need10 / kw10_s, ib10_s) * FT_MIN_TO_KMH / CROWN_WAF
+                                       : 0.0;
+
+                double tr = i0 > 0 ? sib_s / i0 : HUGE_VAL;
+                double ar = cros_s / ra;
+                pti[col + i] = ti;
+                pci[col + i] = ci;
+                ptr[col + i] = tr;
+                par[col + i] = ar;
+                pft[col + i] = tr >= 1.0 ? (ar >= 1.0 ? 3 : 2) : (ar >= 1.0 ? 4 : 1);
+            }
+        }
+    }
+
+    return List::create(Named("torching_index") = torching,
+                        Named("crowning_index") = crowning,
+                        Named("transition_ratio") = transition,
+                        Named("active_ratio") = active,
+                        Named("fire_type") = fire_type);
+}
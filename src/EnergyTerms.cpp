@@ -0,0 +1,1025 @@
+#include <Rcpp.h>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <EmpiricalPatternR/EnergyTerm.h>
+#include "SpatialIndex.h"
+#include "CanopyCover.h"
+#include "CanopyHeight.h"
+#include "SizeHistogram.h"
+
+using namespace Rcpp;
+using namespace std;
+using EmpiricalPatternR::Stand;
+using EmpiricalPatternR::Proposal;
+using EmpiricalPatternR::EnergyTerm;
+using EmpiricalPatternR::PROPOSE_MOVE;
+using EmpiricalPatternR::PROPOSE_SPECIES;
+using EmpiricalPatternR::PROPOSE_DBH;
+
+// ==============================================================================
+// BUILT-IN ENERGY TERMS
+// ==============================================================================
+// The calc_energy() terms used by anneal_stand_native(), on the plugin API of
+// inst/include/EmpiricalPatternR/EnergyTerm.h. Each term scores with the same
+// formula and normalization as calc_energy() and updates its state from the
+// one changed tree:
+//
+//   ce        nearest-neighbour distance per tree, trees in a TorusGrid; a
+//             move rescans the trees whose neighbour was the moved tree and
+//             visits only the cells within the largest NN distance of its
+//             old and new position
+//   cover     crown-count raster (CoverRaster, or StencilCoverRaster with
+//             cached crown footprints); a move is remove + add, a size
+//             change resizes the crown ring
+//   nurse     nearest nurse (juniper) per seeker (pinyon), each group in a
+//             TorusGrid; as ce, a nurse change visits only nearby seekers
+//   species_ce
+//             nearest tree of every species per tree, one TorusGrid per
+//             species; as ce, a move or species change rescans the trees
+//             whose neighbour was the changed tree and visits only the
+//             cells within the largest NN distance to its old and new
+//             species
+//   cfl       total canopy fuel
+//   species   tree count per species
+//   size      sums and sums of squares of DBH and height
+//   dbh_hist, height_hist
+//             class counts per species (SizeHistogram); a species or DBH
+//             change moves one count and rescores the changed species
+//   chm       canopy height raster with per-cell top-k crown lists
+//             (CanopyHeightRaster); a proposal removes the tree and places
+//             it again
+//
+// Pending changes are journalled so rollback() restores the exact state.
+
+struct NeighbourEntry {
+    int i;
+    double d;
+    int j;
+};
+
+// Clark-Evans R, weight * ((R - target) / target)^2
+class CETerm : public EnergyTerm {
+public:
+    CETerm(double target, double weight) : target_(target), weight_(weight), grid_(NULL) {}
+    ~CETerm() { delete grid_; }
+
+    const char* name() const { return "ce"; }
+
+    double init(const Stand& s) {
+        int n = s.n;
+        nn_d_.assign(n, 1000.0);
+        nn_j_.assign(n, -1);
+        journal_.clear();
+        delete grid_;
+        grid_ = new TorusGrid(s.plot_size, s.plot_size, s.plot_size / sqrt((double)max(n, 1)), n);
+        for(int i = 0; i < n; i++) grid_->insert(i, s.x[i], s.y[i]);
+        if(n > 1) {
+            TorusKDTree tree(s.x, s.y, n, s.plot_size, s.plot_size);
+            double d2;
+            int idx;
+            for(int i = 0; i < n; i++) {
+                if(tree.knn(s.x[i], s.y[i], 1, i, &d2, &idx) == 1) {
+                    nn_d_[i] = sqrt(d2);
+                    nn_j_[i] = idx;
+                }
+            }
+        }
+        stamp_.assign(n, -1);
+        mark_ = 0;
+        commits_ = 0;
+        moved_ = false;
+        refresh();
+        energy_ = score(s);
+        return energy_;
+    }
+
+    double propose(const Stand& s, const Proposal& p) {
+        journal_.clear();
+        pending_ = energy_;
+        moved_ = false;
+        if(p.type != PROPOSE_MOVE || s.n < 2) return 0.0;
+        p_ = p;
+        saved_sum_ = sum_;
+        int t = p.tree;
+        double nx = p.after.x, ny = p.after.y;
+        grid_->move(t, nx, ny);
+        moved_ = true;
+
+        // Trees that lose their neighbour are rescanned; others may gain t.
+        // All lie within d_max of the old or the new position.
+        touched_.clear();
+        mark_++;
+        grid_->collect(p.before.x, p.before.y, d_max_, stamp_, mark_, touched_);
+        grid_->collect(nx, ny, d_max_, stamp_, mark_, touched_);
+        int idx;
+        for(size_t k = 0; k < touched_.size(); k++) {
+            int j = touched_[k];
+            if(j == t) continue;
+            if(nn_j_[j] == t) {
+                double d = grid_->nearest(j, idx);
+                set(j, d, idx);
+            } else {
+                double d = grid_->dist(j, nx, ny);
+                if(d < nn_d_[j]) set(j, d, t);
+            }
+        }
+        double d = grid_->nearest(t, idx);
+        set(t, d, idx);
+        pending_ = score(s);
+        return pending_ - energy_;
+    }
+
+    void commit() {
+        energy_ = pending_;
+        for(size_t k = 0; k < journal_.size(); k++) {
+            d_max_ = max(d_max_, nn_d_[journal_[k].i]);
+        }
+        journal_.clear();
+        // d_max only grows between refreshes, so it stays an upper bound
+        if(++commits_ % 1024 == 0) refresh();
+    }
+
+    void rollback() {
+        for(size_t k = journal_.size(); k-- > 0; ) {
+            nn_d_[journal_[k].i] = journal_[k].d;
+            nn_j_[journal_[k].i] = journal_[k].j;
+        }
+        journal_.clear();
+        if(moved_) {
+            grid_->move(p_.tree, p_.before.x, p_.before.y);
+            sum_ = saved_sum_;
+        }
+        moved_ = false;
+    }
+
+private:
+    double target_, weight_, energy_, pending_;
+    double sum_, saved_sum_, d_max_;   // sum and maximum of nn_d_
+    vector<double> nn_d_;
+    vector<int> nn_j_;
+    vector<NeighbourEntry> journal_;
+    TorusGrid* grid_;
+    Proposal p_;
+    bool moved_;
+    long commits_;
+    int mark_;
+    vector<int> stamp_, touched_;      // scratch, kept to avoid reallocation
+
+    void set(int i, double d, int j) {
+        NeighbourEntry e = {i, nn_d_[i], nn_j_[i]};
+        journal_.push_back(e);
+        sum_ += d - nn_d_[i];
+        nn_d_[i] = d;
+        nn_j_[i] = j;
+    }
+
+    // Exact sum (no drift from the running updates) and maximum
+    void refresh() {
+        sum_ = 0.0;
+        d_max_ = 0.0;
+        for(size_t i = 0; i < nn_d_.size(); i++) {
+            sum_ += nn_d_[i];
+            d_max_ = max(d_max_, nn_d_[i]);
+        }
+    }
+
+    double score(const Stand& s) const {
+        double mean = sum_ / s.n;
+        double r = mean / (0.5 * sqrt(s.plot_size * s.plot_size / s.n));
+        double e = (r - target_) / target_;
+        return weight_ * e * e;
+    }
+};
+
+// Canopy cover, weight * ((cover - target) / max(target, 0.1))^2. Raster is
+// CoverRaster (exact, as calc_canopy_cover) or StencilCoverRaster.
+template <class Raster>
+class CoverTerm : public EnergyTerm {
+public:
+    CoverTerm(double target, double weight, double grid_res)
+        : target_(target), weight_(weight), grid_res_(grid_res), raster_(NULL) {}
+    ~CoverTerm() { delete raster_; }
+
+    const char* name() const { return "cover"; }
+
+    double init(const Stand& s) {
+        delete raster_;
+        raster_ = new Raster(s.plot_size, grid_res_);
+        for(int i = 0; i < s.n; i++) raster_->add(s.x[i], s.y[i], s.crown_radius[i]);
+        energy_ = score();
+        return energy_;
+    }
+
+    double propose(const Stand&, const Proposal& p) {
+        p_ = p;
+        apply(p_.before, p_.after);
+        pending_ = score();
+        return pending_ - energy_;
+    }
+
+    void commit() { energy_ = pending_; }
+    void rollback() { apply(p_.after, p_.before); }
+
+private:
+    double target_, weight_, grid_res_, energy_, pending_;
+    Raster* raster_;
+    Proposal p_;
+
+    void apply(const EmpiricalPatternR::TreeState& from,
+               const EmpiricalPatternR::TreeState& to) {
+        if(from.x != to.x || from.y != to.y) {
+            raster_->remove(from.x, from.y, from.crown_radius);
+            raster_->add(to.x, to.y, to.crown_radius);
+        } else {
+            raster_->resize(from.x, from.y, from.crown_radius, to.crown_radius);
+        }
+    }
+
+    double score() const {
+        double e = (raster_->fraction() - target_) / max(target_, 0.1);
+        return weight_ * e * e;
+    }
+};
+
+// Nurse effect, weight * (mean seeker-to-nearest-nurse distance - distance)^2
+// (Euclidean, 0 without seekers or nurses, as calc_nurse_tree_energy)
+class NurseTerm : public EnergyTerm {
+public:
+    NurseTerm(double distance, double weight, const vector<int>& group)
+        : distance_(distance), weight_(weight), group_(group), seekers_(NULL),
+          nurses_(NULL) {}
+    ~NurseTerm() {
+        delete seekers_;
+        delete nurses_;
+    }
+
+    const char* name() const { return "nurse"; }
+
+    double init(const Stand& s) {
+        near_d_.assign(s.n, 1e300);
+        near_j_.assign(s.n, -1);
+        journal_.clear();
+        n_seek_ = n_nurse_ = 0;
+        for(int i = 0; i < s.n; i++) {
+            int g = groupOf(s.species[i]);
+            if(g == 1) n_seek_++;
+            if(g == 2) n_nurse_++;
+        }
+        // Cells of about the mean spacing of each group
+        delete seekers_;
+        delete nurses_;
+        double L = s.plot_size;
+        seekers_ = new TorusGrid(L, L, L / sqrt((double)max(n_seek_, 1)), s.n, false);
+        nurses_ = new TorusGrid(L, L, L / sqrt((double)max(n_nurse_, 1)), s.n, false);
+        for(int i = 0; i < s.n; i++) {
+            int g = groupOf(s.species[i]);
+            if(g == 1) seekers_->insert(i, s.x[i], s.y[i]);
+            if(g == 2) nurses_->insert(i, s.x[i], s.y[i]);
+        }
+        int idx;
+        for(int i = 0; i < s.n; i++) {
+            if(!seekers_->contains(i)) continue;
+            double d = nearestNurse(i, idx);
+            record(i, d, idx);
+        }
+        journal_.clear();
+        stamp_.assign(s.n, -1);
+        mark_ = 0;
+        commits_ = 0;
+        placed_ = resum_ = false;
+        refresh();
+        energy_ = score();
+        return energy_;
+    }
+
+    double propose(const Stand&, const Proposal& p) {
+        journal_.clear();
+        pending_ = energy_;
+        placed_ = resum_ = false;
+        int g_old = groupOf(p.before.species), g_new = groupOf(p.after.species);
+        if(p.type == PROPOSE_DBH || (g_old == 0 && g_new == 0)) return 0.0;
+        int t = p.tree;
+        p_ = p;
+        saved_sum_ = sum_;
+        saved_d_max_ = d_max_;
+        int saved_nurse = n_nurse_;
+        place(p.before, p.after);
+        placed_ = true;
+
+        // A nurse that moves or changes species: its seekers are rescanned;
+        // a nurse at the new position may be nearer to others. All of them
+        // lie within d_max of the old or the new position.
+        int idx;
+        if(g_old == 2 || g_new == 2) {
+            touched_.clear();
+            mark_++;
+            if(g_old == 2) seekers_->collect(p.before.x, p.before.y, d_max_, stamp_, mark_, touched_);
+            if(g_new == 2) seekers_->collect(p.after.x, p.after.y, d_max_, stamp_, mark_, touched_);
+            for(size_t k = 0; k < touched_.size(); k++) {
+                int j = touched_[k];
+                if(j == t) continue;
+                if(g_old == 2 && near_j_[j] == t) {
+                    double d = nearestNurse(j, idx);
+                    set(j, d, idx);
+                } else if(g_new == 2) {
+                    double d = nurses_->dist(t, seekers_->x(j), seekers_->y(j));
+                    if(d < near_d_[j]) set(j, d, t);
+                }
+            }
+        }
+        if(g_new == 1) {
+            double d = nearestNurse(t, idx);
+            if(g_old == 1) {
+                set(t, d, idx);
+            } else {
+                record(t, d, idx);
+                sum_ += d;
+            }
+        } else if(g_old == 1) {
+            sum_ -= near_d_[t];
+        }
+        // Without nurses the distances are placeholders; sum afresh once
+        // the first nurse appears
+        resum_ = saved_nurse == 0 && n_nurse_ > 0;
+        if(resum_) refresh();
+
+        pending_ = score();
+        return pending_ - energy_;
+    }
+
+    void commit() {
+        energy_ = pending_;
+        for(size_t k = 0; k < journal_.size(); k++) {
+            int i = journal_[k].i;
+            if(seekers_->contains(i)) d_max_ = max(d_max_, near_d_[i]);
+        }
+        journal_.clear();
+        placed_ = false;
+        if(++commits_ % 1024 == 0 || resum_) refresh();
+        resum_ = false;
+    }
+
+    void rollback() {
+        for(size_t k = journal_.size(); k-- > 0; ) {
+            near_d_[journal_[k].i] = journal_[k].d;
+            near_j_[journal_[k].i] = journal_[k].j;
+        }
+        journal_.clear();
+        if(placed_) {
+            place(p_.after, p_.before);
+            sum_ = saved_sum_;
+            d_max_ = saved_d_max_;
+        }
+        placed_ = resum_ = false;
+    }
+
+private:
+    double distance_, weight_, energy_, pending_;
+    vector<int> group_;                // per species: 1 = seeker, 2 = nurse
+    vector<double> near_d_;
+    vector<int> near_j_;
+    vector<NeighbourEntry> journal_;
+    TorusGrid* seekers_;               // Euclidean grids of the two groups
+    TorusGrid* nurses_;
+    int n_seek_, n_nurse_;
+    double sum_, d_max_;               // sum and maximum of near_d_ over seekers
+    double saved_sum_, saved_d_max_;
+    Proposal p_;
+    bool placed_, resum_;
+    long commits_;
+    int mark_;
+    vector<int> stamp_, touched_;      // scratch, kept to avoid reallocation
+
+    int groupOf(int sp) const {
+        return sp >= 0 && sp < (int)group_.size() ? group_[sp] : 0;
+    }
+
+    void record(int i, double d, int j) {
+        NeighbourEntry e = {i, near_d_[i], near_j_[i]};
+        journal_.push_back(e);
+        near_d_[i] = d;
+        near_j_[i] = j;
+    }
+
+    // record() for a seeker counted in sum_
+    void set(int i, double d, int j) {
+        sum_ += d - near_d_[i];
+        record(i, d, j);
+    }
+
+    double nearestNurse(int i, int& idx) const {
+        return nurses_->nearest(seekers_->x(i), seekers_->y(i), -1, idx);
+    }
+
+    // Move tree p_.tree between the group grids
+    void place(const EmpiricalPatternR::TreeState& from,
+               const EmpiricalPatternR::TreeState& to) {
+        int t = p_.tree, g_from = groupOf(from.species), g_to = groupOf(to.species);
+        if(g_from == 1) {
+            seekers_->remove(t);
+            n_seek_--;
+        } else if(g_from == 2) {
+            nurses_->remove(t);
+            n_nurse_--;
+        }
+        if(g_to == 1) {
+            seekers_->insert(t, to.x, to.y);
+            n_seek_++;
+        } else if(g_to == 2) {
+            nurses_->insert(t, to.x, to.y);
+            n_nurse_++;
+        }
+    }
+
+    // Exact sum (no drift from the running updates) and maximum
+    void refresh() {
+        sum_ = 0.0;
+        d_max_ = 0.0;
+        for(size_t i = 0; i < near_d_.size(); i++) {
+            if(!seekers_->contains((int)i)) continue;
+            sum_ += near_d_[i];
+            d_max_ = max(d_max_, near_d_[i]);
+        }
+    }
+
+    double score() const {
+        if(n_seek_ == 0 || n_nurse_ == 0) return 0.0;
+        double e = sum_ / n_seek_ - distance_;
+        return weight_ * e * e;
+    }
+};
+
+// Within-species Clark-Evans R and cross-type NN indices (calc_species_ce):
+// ce_weight * mean((R_aa - target) / target)^2 over the targeted species plus
+// cross_weight * the same mean over the targeted species pairs, skipping
+// indices that are undefined (too few trees), as calc_energy. Targets are
+// NA where not given.
+class SpeciesCETerm : public EnergyTerm {
+public:
+    SpeciesCETerm(double ce_weight, double cross_weight, const vector<double>& ce_target,
+                  const vector<double>& cross_target)
+        : ce_weight_(ce_weight), cross_weight_(cross_weight), ce_target_(ce_target),
+          cross_target_(cross_target), S_((int)ce_target.size()), all_(NULL) {}
+    ~SpeciesCETerm() { clearGrids(); }
+
+    const char* name() const { return "species_ce"; }
+
+    double init(const Stand& s) {
+        n_ = s.n;
+        L_ = s.plot_size;
+        clearGrids();
+        double cell = L_ / sqrt(max((double)n_ / max(S_, 1), 1.0));
+        all_ = new TorusGrid(L_, L_, L_ / sqrt((double)max(n_, 1)), n_);
+        grids_.assign(S_, NULL);
+        for(int b = 0; b < S_; b++) grids_[b] = new TorusGrid(L_, L_, cell, n_);
+        sp_.assign(s.species, s.species + n_);
+        count_.assign(S_, 0);
+        for(int i = 0; i < n_; i++) {
+            if(sp_[i] < 0 || sp_[i] >= S_) stop("species codes out of range in species_ce");
+            all_->insert(i, s.x[i], s.y[i]);
+            grids_[sp_[i]]->insert(i, s.x[i], s.y[i]);
+            count_[sp_[i]]++;
+        }
+        d_.assign((size_t)n_ * S_, INFINITY);
+        id_.assign((size_t)n_ * S_, -1);
+        for(int i = 0; i < n_; i++) {
+            for(int b = 0; b < S_; b++) {
+                int idx;
+                d_[(size_t)i * S_ + b] = grids_[b]->nearest(s.x[i], s.y[i], i, idx, INFINITY);
+                id_[(size_t)i * S_ + b] = idx;
+            }
+        }
+        journal_.clear();
+        stamp_.assign(n_, -1);
+        mark_ = 0;
+        commits_ = 0;
+        moved_ = false;
+        refresh();
+        energy_ = score();
+        return energy_;
+    }
+
+    double propose(const Stand&, const Proposal& p) {
+        journal_.clear();
+        pending_ = energy_;
+        moved_ = false;
+        const EmpiricalPatternR::TreeState& a = p.before;
+        const EmpiricalPatternR::TreeState& b = p.after;
+        if(p.type == PROPOSE_DBH ||
+           (a.x == b.x && a.y == b.y && a.species == b.species)) return 0.0;
+        p_ = p;
+        saved_sum_ = sum_;
+        int t = p.tree, os = a.species, ns = b.species;
+        addRow(t, -1.0);
+        place(t, b, os);
+        moved_ = true;
+
+        // Trees whose nearest os-tree was t are rescanned; others may gain t
+        // as their nearest ns-tree. All lie within the largest distance to
+        // those species of the old or the new position.
+        touched_.clear();
+        mark_++;
+        all_->collect(a.x, a.y, d_max_[os], stamp_, mark_, touched_);
+        all_->collect(b.x, b.y, d_max_[ns], stamp_, mark_, touched_);
+        int idx;
+        for(size_t k = 0; k < touched_.size(); k++) {
+            int j = touched_[k];
+            if(j == t) continue;
+            size_t jo = (size_t)j * S_ + os, jn = (size_t)j * S_ + ns;
+            if(id_[jo] == t) {
+                double d = grids_[os]->nearest(all_->x(j), all_->y(j), j, idx, INFINITY);
+                set(jo, d, idx);
+            }
+            double d = all_->dist(j, b.x, b.y);
+            if(d < d_[jn]) set(jn, d, t);
+        }
+        for(int c = 0; c < S_; c++) {
+            double d = grids_[c]->nearest(b.x, b.y, t, idx, INFINITY);
+            record((size_t)t * S_ + c, d, idx);
+        }
+        addRow(t, 1.0);
+        pending_ = score();
+        return pending_ - energy_;
+    }
+
+    void commit() {
+        energy_ = pending_;
+        for(size_t k = 0; k < journal_.size(); k++) {
+            size_t f = journal_[k].i;
+            d_max_[f % S_] = max(d_max_[f % S_], d_[f]);
+        }
+        journal_.clear();
+        moved_ = false;
+        // d_max only grows between refreshes, so it stays an upper bound
+        if(++commits_ % 1024 == 0) refresh();
+    }
+
+    void rollback() {
+        for(size_t k = journal_.size(); k-- > 0; ) {
+            d_[journal_[k].i] = journal_[k].d;
+            id_[journal_[k].i] = journal_[k].j;
+        }
+        journal_.clear();
+        if(moved_) {
+            place(p_.tree, p_.before, p_.after.species);
+            sum_ = saved_sum_;
+        }
+        moved_ = false;
+    }
+
+private:
+    // Journal entry of one stored distance (i: flat index tree * S + species)
+    struct Entry {
+        size_t i;
+        double d;
+        int j;
+    };
+
+    double ce_weight_, cross_weight_, energy_, pending_, L_;
+    vector<double> ce_target_, cross_target_;  // cross_target_[a * S + b]
+    int S_, n_;
+    vector<int> sp_, count_;
+    vector<double> d_;                 // d_[i * S + b]: distance to the nearest b-tree
+    vector<int> id_;                   // that tree (-1 if none)
+    vector<double> sum_, saved_sum_;   // sum_[a * S + b]: finite d_ over a-trees
+    vector<double> d_max_;             // per species b: maximum of d_[., b]
+    vector<Entry> journal_;
+    vector<TorusGrid*> grids_;         // trees of each species
+    TorusGrid* all_;                   // all trees
+    Proposal p_;
+    bool moved_;
+    long commits_;
+    int mark_;
+    vector<int> stamp_, touched_;      // scratch, kept to avoid reallocation
+
+    void clearGrids() {
+        for(size_t b = 0; b < grids_.size(); b++) delete grids_[b];
+        grids_.clear();
+        delete all_;
+        all_ = NULL;
+    }
+
+    // Tree t to state `to`, leaving species `from`
+    void place(int t, const EmpiricalPatternR::TreeState& to, int from) {
+        grids_[from]->remove(t);
+        grids_[to.species]->insert(t, to.x, to.y);
+        all_->move(t, to.x, to.y);
+        count_[from]--;
+        count_[to.species]++;
+        sp_[t] = to.species;
+    }
+
+    void record(size_t f, double d, int j) {
+        Entry e = {f, d_[f], id_[f]};
+        journal_.push_back(e);
+        d_[f] = d;
+        id_[f] = j;
+    }
+
+    // record() for a distance counted in sum_
+    void set(size_t f, double d, int j) {
+        double& s = sum_[(size_t)sp_[f / S_] * S_ + f % S_];
+        if(std::isfinite(d_[f])) s -= d_[f];
+        if(std::isfinite(d)) s += d;
+        record(f, d, j);
+    }
+
+    // Add (sign = 1) or remove (sign = -1) tree i's distances from the sums
+    void addRow(int i, double sign) {
+        for(int b = 0; b < S_; b++) {
+            double d = d_[(size_t)i * S_ + b];
+            if(std::isfinite(d)) sum_[(size_t)sp_[i] * S_ + b] += sign * d;
+        }
+    }
+
+    // Exact sums (no drift from the running updates) and maxima
+    void refresh() {
+        sum_.assign((size_t)S_ * S_, 0.0);
+        d_max_.assign(S_, 0.0);
+        for(int i = 0; i < n_; i++) {
+            for(int b = 0; b < S_; b++) {
+                double d = d_[(size_t)i * S_ + b];
+                d_max_[b] = max(d_max_[b], d);
+                if(std::isfinite(d)) sum_[(size_t)sp_[i] * S_ + b] += d;
+            }
+        }
+    }
+
+    // NN index of a-trees to b-trees; NaN when undefined
+    double index(int a, int b) const {
+        int nb = count_[b];
+        if(count_[a] == 0 || (a == b ? nb < 2 : nb < 1)) return NAN;
+        return (sum_[(size_t)a * S_ + b] / count_[a]) / (0.5 * sqrt(L_ * L_ / nb));
+    }
+
+    double score() const {
+        double ce = 0.0, cross = 0.0;
+        int n_ce = 0, n_cross = 0;
+        for(int a = 0; a < S_; a++) {
+            for(int b = 0; b < S_; b++) {
+                double t = cross_target_[(size_t)a * S_ + b];
+                bool want_ce = a == b && !std::isnan(ce_target_[a]);
+                if(!want_ce && std::isnan(t)) continue;
+                double r = index(a, b);
+                if(std::isnan(r)) continue;
+                if(want_ce) {
+                    double e = (r - ce_target_[a]) / ce_target_[a];
+                    ce += e * e;
+                    n_ce++;
+                }
+                if(!std::isnan(t)) {
+                    double e = (r - t) / t;
+                    cross += e * e;
+                    n_cross++;
+                }
+            }
+        }
+        return (n_ce > 0 ? ce_weight_ * ce / n_ce : 0.0) +
+               (n_cross > 0 ? cross_weight_ * cross / n_cross : 0.0);
+    }
+};
+
+// Canopy fuel load, weight * ((CFL - target) / target)^2
+class CFLTerm : public EnergyTerm {
+public:
+    CFLTerm(double target, double weight) : target_(target), weight_(weight) {}
+
+    const char* name() const { return "cfl"; }
+
+    double init(const Stand& s) {
+        area_ = s.plot_size * s.plot_size;
+        fuel_ = 0.0;
+        for(int i = 0; i < s.n; i++) fuel_ += s.fuel_mass[i];
+        energy_ = score(fuel_);
+        return energy_;
+    }
+
+    double propose(const Stand&, const Proposal& p) {
+        pending_fuel_ = fuel_ + p.after.fuel_mass - p.before.fuel_mass;
+        pending_ = score(pending_fuel_);
+        return pending_ - energy_;
+    }
+
+    void commit() {
+        fuel_ = pending_fuel_;
+        energy_ = pending_;
+    }
+    void rollback() {}
+
+private:
+    double target_, weight_, area_, fuel_, pending_fuel_, energy_, pending_;
+
+    double score(double fuel) const {
+        double e = (fuel / area_ - target_) / target_;
+        return weight_ * e * e;
+    }
+};
+
+// Species composition, weight * sum((prop - target)^2)
+class SpeciesTerm : public EnergyTerm {
+public:
+    SpeciesTerm(const vector<double>& target, double weight)
+        : target_(target), weight_(weight) {}
+
+    const char* name() const { return "species"; }
+
+    double init(const Stand& s) {
+        n_ = s.n;
+        count_.assign(target_.size(), 0);
+        for(int i = 0; i < s.n; i++) {
+            if(s.species[i] >= 0 && s.species[i] < (int)count_.size()) count_[s.species[i]]++;
+        }
+        energy_ = score();
+        return energy_;
+    }
+
+    double propose(const Stand&, const Proposal& p) {
+        p_ = p;
+        pending_ = energy_;
+        if(p.before.species == p.after.species) return 0.0;
+        shift(p.before.species, p.after.species);
+        pending_ = score();
+        shift(p.after.species, p.before.species);
+        return pending_ - energy_;
+    }
+
+    void commit() {
+        if(p_.before.species != p_.after.species) shift(p_.before.species, p_.after.species);
+        energy_ = pending_;
+    }
+    void rollback() {}
+
+private:
+    vector<double> target_;
+    double weight_, energy_, pending_;
+    int n_;
+    vector<int> count_;
+    Proposal p_;
+
+    void shift(int from, int to) {
+        if(from >= 0 && from < (int)count_.size()) count_[from]--;
+        if(to >= 0 && to < (int)count_.size()) count_[to]++;
+    }
+
+    double score() const {
+        double e = 0.0;
+        for(size_t k = 0; k < count_.size(); k++) {
+            double d = (double)count_[k] / n_ - target_[k];
+            e += d * d;
+        }
+        return weight_ * e;
+    }
+};
+
+// Mean and SD of DBH and height, normalized as in calc_energy (SDs by the
+// target mean). Sums are refreshed from the stand every REFRESH_EVERY commits
+// so rounding does not accumulate over long runs.
+class SizeTerm : public EnergyTerm {
+public:
+    // target and weight: dbh_mean, dbh_sd, height_mean, height_sd
+    SizeTerm(const vector<double>& target, const vector<double>& weight)
+        : target_(target), weight_(weight) {}
+
+    const char* name() const { return "size"; }
+
+    double init(const Stand& s) {
+        refresh(s);
+        energy_ = score(sum_);
+        return energy_;
+    }
+
+    double propose(const Stand& s, const Proposal& p) {
+        if(commits_ >= REFRESH_EVERY) {
+            refresh(s);
+            energy_ = score(sum_);
+        }
+        for(int k = 0; k < 4; k++) pending_sum_[k] = sum_[k];
+        if(p.type == PROPOSE_MOVE) {
+            pending_ = energy_;
+            return 0.0;
+        }
+        pending_sum_[0] += p.after.dbh - p.before.dbh;
+        pending_sum_[1] += p.after.dbh * p.after.dbh - p.before.dbh * p.before.dbh;
+        pending_sum_[2] += p.after.height - p.before.height;
+        pending_sum_[3] += p.after.height * p.after.height - p.before.height * p.before.height;
+        pending_ = score(pending_sum_);
+        return pending_ - energy_;
+    }
+
+    void commit() {
+        for(int k = 0; k < 4; k++) sum_[k] = pending_sum_[k];
+        energy_ = pending_;
+        commits_++;
+    }
+    void rollback() {}
+
+private:
+    static const int REFRESH_EVERY = 4096;
+    vector<double> target_, weight_;
+    double sum_[4], pending_sum_[4];     // dbh, dbh^2, height, height^2
+    double energy_, pending_;
+    int n_, commits_;
+
+    void refresh(const Stand& s) {
+        n_ = s.n;
+        commits_ = 0;
+        for(int k = 0; k < 4; k++) sum_[k] = 0.0;
+        for(int i = 0; i < s.n; i++) {
+            sum_[0] += s.dbh[i];
+            sum_[1] += s.dbh[i] * s.dbh[i];
+            sum_[2] += s.height[i];
+            sum_[3] += s.height[i] * s.height[i];
+        }
+    }
+
+    double score(const double* sum) const {
+        double m_d = sum[0] / n_, m_h = sum[2] / n_;
+        double sd_d = n_ > 1 ? sqrt(max(0.0, (sum[1] - n_ * m_d * m_d) / (n_ - 1))) : 0.0;
+        double sd_h = n_ > 1 ? sqrt(max(0.0, (sum[3] - n_ * m_h * m_h) / (n_ - 1))) : 0.0;
+        double e[4] = {(m_d - target_[0]) / target_[0], (sd_d - target_[1]) / target_[0],
+                       (m_h - target_[2]) / target_[2], (sd_h - target_[3]) / target_[2]};
+        double total = 0.0;
+        for(int k = 0; k < 4; k++) total += weight_[k] * e[k] * e[k];
+        return total;
+    }
+};
+
+// DBH or height class distribution, weight * the histogram distance averaged
+// over the target columns, as calc_histogram_energy. column[s] is the target
+// column of species s (-1 for species the target leaves out; all 0 when the
+// target pools species).
+class HistogramTerm : public EnergyTerm {
+public:
+    HistogramTerm(bool height, double weight, double origin, double width, int n_bins,
+                  int method, const vector<double>& target, const vector<int>& column)
+        : height_(height), weight_(weight), column_(column),
+          hist_(origin, width, n_bins, (int)target.size() / n_bins) {
+        hist_.setTarget(target.data(), method);
+    }
+
+    const char* name() const { return height_ ? "height_hist" : "dbh_hist"; }
+
+    double init(const Stand& s) {
+        hist_.clear();
+        for(int i = 0; i < s.n; i++) {
+            int c = column(s.species[i]);
+            if(c >= 0) hist_.add(height_ ? s.height[i] : s.dbh[i], c);
+        }
+        energy_ = weight_ * hist_.energy();
+        return energy_;
+    }
+
+    double propose(const Stand&, const Proposal& p) {
+        p_ = p;
+        pending_ = energy_;
+        if(p.type == PROPOSE_MOVE) return 0.0;
+        shift(p.before, p.after);
+        pending_ = weight_ * hist_.energy();
+        return pending_ - energy_;
+    }
+
+    void commit() { energy_ = pending_; }
+    void rollback() {
+        if(p_.type != PROPOSE_MOVE) shift(p_.after, p_.before);
+    }
+
+private:
+    bool height_;
+    double weight_, energy_, pending_;
+    vector<int> column_;
+    SizeHistogram hist_;
+    Proposal p_;
+
+    int column(int species) const {
+        return species >= 0 && species < (int)column_.size() ? column_[species] : -1;
+    }
+
+    double value(const EmpiricalPatternR::TreeState& t) const {
+        return height_ ? t.height : t.dbh;
+    }
+
+    void shift(const EmpiricalPatternR::TreeState& from, const EmpiricalPatternR::TreeState& to) {
+        int a = column(from.species), b = column(to.species);
+        if(a >= 0 && b >= 0) {
+            hist_.update(value(from), a, value(to), b);
+        } else {
+            if(a >= 0) hist_.remove(value(from), a);
+            if(b >= 0) hist_.add(value(to), b);
+        }
+    }
+};
+
+// CHM percentiles, weight * sum(((percentile - target) / target)^2) over
+// the requested probabilities, for fitting stands to lidar canopy metrics
+class CHMTerm : public EnergyTerm {
+public:
+    CHMTerm(double weight, double grid_res, int profile, int top_k, double min_height,
+            double height_res, const vector<double>& probs, const vector<double>& target)
+        : weight_(weight), grid_res_(grid_res), min_height_(min_height),
+          height_res_(height_res), profile_(profile), top_k_(top_k), probs_(probs),
+          target_(target), raster_(NULL) {}
+    ~CHMTerm() { delete raster_; }
+
+    const char* name() const { return "chm"; }
+
+    double init(const Stand& s) {
+        delete raster_;
+        raster_ = new CanopyHeightRaster(s.plot_size, grid_res_, profile_, top_k_, height_res_);
+        for(int i = 0; i < s.n; i++) {
+            raster_->add(i, s.x[i], s.y[i], s.crown_radius[i], s.height[i], s.crown_base[i]);
+        }
+        energy_ = score();
+        return energy_;
+    }
+
+    double propose(const Stand&, const Proposal& p) {
+        p_ = p;
+        place(p_.tree, p_.after);
+        pending_ = score();
+        return pending_ - energy_;
+    }
+
+    void commit() { energy_ = pending_; }
+    void rollback() { place(p_.tree, p_.before); }
+
+private:
+    double weight_, grid_res_, min_height_, height_res_, energy_, pending_;
+    int profile_, top_k_;
+    vector<double> probs_, target_;
+    CanopyHeightRaster* raster_;
+    Proposal p_;
+
+    void place(int i, const EmpiricalPatternR::TreeState& t) {
+        raster_->remove(i);
+        raster_->add(i, t.x, t.y, t.crown_radius, t.height, t.crown_base);
+    }
+
+    double score() const {
+        double total = 0.0;
+        for(size_t k = 0; k < probs_.size(); k++) {
+            double e = (raster_->percentile(probs_[k], min_height_) - target_[k]) / target_[k];
+            total += e * e;
+        }
+        return weight_ * total;
+    }
+};
+
+// Built-in term by name. params: ce, cfl = (target, weight); cover = (target,
+// weight, grid_res[, stencil]); nurse = (distance, weight) with group giving 1 (seeker),
+// 2 (nurse) or 0 per species; species = (weight, target proportions...);
+// size = (4 targets, 4 weights) in the order dbh_mean, dbh_sd, height_mean,
+// height_sd; species_ce = (ce weight, cross weight, S, S within-species
+// targets, S x S cross targets column-major), NA where not targeted;
+// chm = (weight, grid_res, profile, top_k, min_height, height_res,
+// probabilities..., target percentiles...); dbh_hist, height_hist = (weight,
+// origin, width, n_bins, method, target counts column-major...) with group
+// giving the 0-based target column (or -1) per species.
+// [[Rcpp::export]]
+SEXP energyTermBuiltin(std::string name, NumericVector params,
+                       IntegerVector group = IntegerVector(0)) {
+    int np = params.size();
+    EnergyTerm* term = NULL;
+    if(name == "ce" && np == 2) {
+        term = new CETerm(params[0], params[1]);
+    } else if(name == "cover" && (np == 3 || np == 4)) {
+        if(np == 4 && params[3] != 0) {
+            term = new CoverTerm<StencilCoverRaster>(params[0], params[1], params[2]);
+        } else {
+            term = new CoverTerm<CoverRaster>(params[0], params[1], params[2]);
+        }
+    } else if(name == "nurse" && np == 2) {
+        term = new NurseTerm(params[0], params[1], vector<int>(group.begin(), group.end()));
+    } else if(name == "species_ce" && np >= 3 && params[2] >= 1 &&
+              np == 3 + (int)params[2] * (1 + (int)params[2])) {
+        int S = (int)params[2];
+        vector<double> cross(S * S);
+        for(int a = 0; a < S; a++) {
+            for(int b = 0; b < S; b++) cross[a * S + b] = params[3 + S + b * S + a];
+        }
+        term = new SpeciesCETerm(params[0], params[1],
+                                 vector<double>(params.begin() + 3, params.begin() + 3 + S), cross);
+    } else if(name == "cfl" && np == 2) {
+        term = new CFLTerm(params[0], params[1]);
+    } else if(name == "species" && np >= 2) {
+        term = new SpeciesTerm(vector<double>(params.begin() + 1, params.end()), params[0]);
+    } else if(name == "size" && np == 8) {
+        term = new SizeTerm(vector<double>(params.begin(), params.begin() + 4),
+                            vector<double>(params.begin() + 4, params.end()));
+    } else if(name == "chm" && np >= 8 && (np - 6) % 2 == 0) {
+        int m = (np - 6) / 2;
+        term = new CHMTerm(params[0], params[1], (int)params[2], (int)params[3], params[4],
+                           params[5], vector<double>(params.begin() + 6, params.begin() + 6 + m),
+                           vector<double>(params.begin() + 6 + m, params.end()));
+    } else if((name == "dbh_hist" || name == "height_hist") && np > 5 &&
+              params[3] >= 1 && (np - 5) % (int)params[3] == 0) {
+        term = new HistogramTerm(name == "height_hist", params[0], params[1], params[2],
+                                 (int)params[3], (int)params[4],
+                                 vector<double>(params.begin() + 5, params.end()),
+                                 vector<int>(group.begin(), group.end()));
+    } else {
+        stop("unknown energy term '%s' or wrong number of parameters", name);
+    }
+    return EmpiricalPatternR::wrapEnergyTerm(term);
+}
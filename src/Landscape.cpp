@@ -0,0 +1,242 @@
+#include <Rcpp.h>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "SpatialIndex.h"
+#include "StandRNG.h"
+#include "RunControl.h"
+
+using namespace Rcpp;
+using namespace std;
+
+// ==============================================================================
+// SEAM REPAIR FOR TILED LANDSCAPES
+// ==============================================================================
+// A landscape of nx x ny optimized tiles is periodic within each tile but not
+// across tile borders: the trees on either side of a seam were never scored
+// together. The repair anneals only the seam trees (closer than seam_width to
+// a border of their tile), with local moves that keep them in the seam band,
+// towards the nearest-neighbour distance distribution of the tiles
+// themselves:
+//
+//   E = ((mean_seam - mean_tile) / mean_tile)^2 + ((sd_seam - sd_tile) / mean_tile)^2
+//
+// where mean_tile / sd_tile are the toroidal NN distances within each tile
+// (the pattern the tiles were optimized for) and mean_seam / sd_seam the NN
+// distances of the seam trees in the landscape, which is itself treated as a
+// torus. The annealing works on n_seam * E, so that the energy change of one
+// move, and with it a sensible temperature, does not depend on the size of
+// the landscape. Trees are kept in a uniform cell grid (TorusGrid), so a move
+// only revisits the seam trees within the largest NN distance of its old and
+// new positions.
+
+struct SeamEntry {
+    int i;
+    double d;
+    int j;
+};
+
+// Seam NN state with a journal for rollback and running sums s1 / s2
+struct SeamState {
+    vector<double> nn_d;
+    vector<int> nn_j;
+    vector<SeamEntry> journal;
+    double s1, s2;
+
+    void set(int i, double d, int j) {
+        SeamEntry e = {i, nn_d[i], nn_j[i]};
+        journal.push_back(e);
+        s1 += d - nn_d[i];
+        s2 += d * d - nn_d[i] * nn_d[i];
+        nn_d[i] = d;
+        nn_j[i] = j;
+    }
+
+    void rollback() {
+        for(size_t k = journal.size(); k-- > 0; ) {
+            const SeamEntry& e = journal[k];
+            s1 += e.d - nn_d[e.i];
+            s2 += e.d * e.d - nn_d[e.i] * nn_d[e.i];
+            nn_d[e.i] = e.d;
+            nn_j[e.i] = e.j;
+        }
+        journal.clear();
+    }
+};
+
+// Distance from a landscape position to the nearest border of its tile
+static inline double borderDistance(double px, double py, double tile_size) {
+    double lx = fmod(px, tile_size), ly = fmod(py, tile_size);
+    return min(min(lx, tile_size - lx), min(ly, tile_size - ly));
+}
+
+// n_seam * E
+static double seamEnergy(double s1, double s2, int n, double mean_t, double sd_t) {
+    if(n < 1) return 0.0;
+    double mean = s1 / n;
+    double sd = sqrt(max(s2 / n - mean * mean, 0.0));
+    double em = (mean - mean_t) / mean_t, es = (sd - sd_t) / mean_t;
+    return n * (em * em + es * es);
+}
+
+// [[Rcpp::export]]
+List repairSeamsCpp(NumericVector x, NumericVector y, IntegerVector tile, int nx, int ny,
+                    double tile_size, double seam_width, double max_shift,
+                    int iterations, double initial_temp = 1e-3, double final_temp = 1e-5,
+                    int seed = 1, double progress = 0.0) {
+    int n = x.size();
+    if(y.size() != n || tile.size() != n) stop("x, y and tile must have the same length");
+    if(nx < 1 || ny < 1 || tile_size <= 0) stop("invalid tile layout");
+    int n_tiles = nx * ny;
+    double width = nx * tile_size, height = ny * tile_size;
+
+    // Target: toroidal NN distances within each tile
+    vector<vector<int> > members(n_tiles);
+    for(int i = 0; i < n; i++) {
+        if(tile[i] < 1 || tile[i] > n_tiles) stop("tile indices must be in 1..%d", n_tiles);
+        members[tile[i] - 1].push_back(i);
+    }
+    double t1 = 0.0, t2 = 0.0;
+    long t_n = 0;
+    for(int t = 0; t < n_tiles; t++) {
+        int m = (int)members[t].size();
+        if(m < 2) continue;
+        double ox = (t % nx) * tile_size, oy = (t / nx) * tile_size;
+        vector<double> lx(m), ly(m);
+        for(int k = 0; k < m; k++) {
+            lx[k] = x[members[t][k]] - ox;
+            ly[k] = y[members[t][k]] - oy;
+        }
+        TorusKDTree tree(lx.data(), ly.data(), m, tile_size, tile_size);
+        for(int k = 0; k < m; k++) {
+            double d = sqrt(tree.nearest2(lx[k], ly[k], k, 0.0));
+            t1 += d;
+            t2 += d * d;
+            t_n++;
+        }
+    }
+    if(t_n < 2) stop("tiles must hold at least two trees");
+    double mean_t = t1 / t_n;
+    double sd_t = sqrt(max(t2 / t_n - mean_t * mean_t, 0.0));
+
+    vector<double> px(x.begin(), x.end()), py(y.begin(), y.end());
+    TorusGrid grid(width, height, max(mean_t, 1e-3), n);
+    for(int i = 0; i < n; i++) grid.insert(i, px[i], py[i]);
+
+    // Seam trees and their NN distances in the landscape
+    vector<int> seam;
+    vector<char> in_seam(n, 0);
+    for(int i = 0; i < n; i++) {
+        if(borderDistance(px[i], py[i], tile_size) < seam_width) {
+            seam.push_back(i);
+            in_seam[i] = 1;
+        }
+    }
+    int n_seam = (int)seam.size();
+    SeamState st;
+    st.nn_d.assign(n, 0.0);
+    st.nn_j.assign(n, -1);
+    st.s1 = st.s2 = 0.0;
+    double d_max = 0.0;
+    for(int k = 0; k < n_seam; k++) {
+        int i = seam[k], j;
+        double d = grid.nearest(i, j);
+        st.set(i, d, j);
+        d_max = max(d_max, d);
+    }
+    st.journal.clear();
+    double energy = seamEnergy(st.s1, st.s2, n_seam, mean_t, sd_t);
+    double energy_before = energy;
+    double mean_before = n_seam > 0 ? st.s1 / n_seam : NA_REAL;
+    double sd_before = n_seam > 0 ?
+        sqrt(max(st.s2 / n_seam - mean_before * mean_before, 0.0)) : NA_REAL;
+
+    StandRNG rng((uint64_t)(unsigned int)seed);
+    double cooling = iterations > 1 ? pow(final_temp / initial_temp, 1.0 / (iterations - 1)) : 1.0;
+    double temperature = initial_temp;
+    vector<int> stamp(n, -1), touched;
+    long accepted = 0;
+    RunControl run("seam repair", iterations, progress);
+    run.energy.store(n_seam > 0 ? energy / n_seam : 0.0);
+    run.best.store(n_seam > 0 ? energy / n_seam : 0.0);
+
+    for(int iter = 0; iter < iterations && n_seam > 0; iter++, temperature *= cooling) {
+        run.done.store(iter, memory_order_relaxed);
+        if(run.poll()) break;
+        int i = seam[min(n_seam - 1, (int)(rng.uniform() * n_seam))];
+        double ox = grid.x(i), oy = grid.y(i);
+        double qx = fmod(ox + (2.0 * rng.uniform() - 1.0) * max_shift + width, width);
+        double qy = fmod(oy + (2.0 * rng.uniform() - 1.0) * max_shift + height, height);
+        if(borderDistance(qx, qy, tile_size) >= seam_width) continue;
+
+        // Seam trees that lose i as their neighbour are rescanned; others may
+        // gain it. All lie within d_max of the old or the new position.
+        grid.move(i, qx, qy);
+        touched.clear();
+        grid.collect(ox, oy, d_max, stamp, iter, touched);
+        grid.collect(qx, qy, d_max, stamp, iter, touched);
+        for(size_t k = 0; k < touched.size(); k++) {
+            int j = touched[k];
+            if(j == i || !in_seam[j]) continue;
+            if(st.nn_j[j] == i) {
+                int idx;
+                double d = grid.nearest(j, idx);
+                st.set(j, d, idx);
+            } else {
+                double d = grid.dist(j, qx, qy);
+                if(d < st.nn_d[j]) st.set(j, d, i);
+            }
+        }
+        int idx;
+        double d = grid.nearest(i, idx);
+        st.set(i, d, idx);
+
+        double e_new = seamEnergy(st.s1, st.s2, n_seam, mean_t, sd_t);
+        double delta = e_new - energy;
+        if(delta < 0 || rng.uniform() < exp(-delta / temperature)) {
+            energy = e_new;
+            for(size_t k = 0; k < st.journal.size(); k++) {
+                d_max = max(d_max, st.nn_d[st.journal[k].i]);
+            }
+            st.journal.clear();
+            accepted++;
+            run.accepted.store(accepted, memory_order_relaxed);
+            run.energy.store(energy / n_seam, memory_order_relaxed);
+            run.best.store(min(run.best.load(memory_order_relaxed), energy / n_seam),
+                           memory_order_relaxed);
+            // d_max only grows between refreshes, so it stays an upper bound
+            if(accepted % 1024 == 0) {
+                d_max = 0.0;
+                for(int k = 0; k < n_seam; k++) d_max = max(d_max, st.nn_d[seam[k]]);
+            }
+        } else {
+            st.rollback();
+            grid.move(i, ox, oy);
+        }
+    }
+    if(!run.stopped()) run.done.store(iterations, memory_order_relaxed);
+    run.finish();
+
+    NumericVector out_x(n), out_y(n);
+    for(int i = 0; i < n; i++) {
+        out_x[i] = grid.x(i);
+        out_y[i] = grid.y(i);
+    }
+    double mean_after = n_seam > 0 ? st.s1 / n_seam : NA_REAL;
+    double sd_after = n_seam > 0 ?
+        sqrt(max(st.s2 / n_seam - mean_after * mean_after, 0.0)) : NA_REAL;
+
+    return List::create(Named("x") = out_x,
+                        Named("y") = out_y,
+                        Named("seam") = LogicalVector(in_seam.begin(), in_seam.end()),
+                        Named("target_mean") = mean_t,
+                        Named("target_sd") = sd_t,
+                        Named("mean_before") = mean_before,
+                        Named("sd_before") = sd_before,
+                        Named("mean_after") = mean_after,
+                        Named("sd_after") = sd_after,
+                        Named("energy_before") = n_seam > 0 ? energy_before / n_seam : 0.0,
+                        Named("energy") = n_seam > 0 ? energy / n_seam : 0.0,
+                        Named("accepted") = (double)accepted,
+                        Named("interrupted") = run.stopped());
+}
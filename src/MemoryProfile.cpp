@@ -0,0 +1,153 @@
+#include <Rcpp.h>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "MemoryProfile.h"
+
+using namespace std;
+
+// ==============================================================================
+// COUNTING OPERATOR NEW / DELETE
+// ==============================================================================
+// Replacements for the package library (see MemoryProfile.h), compiled only
+// when the package is built with -DEPR_COUNT_ALLOC. Which calls reach them
+// depends on how the platform binds the symbols:
+//
+//   ELF      R opens package libraries with RTLD_LOCAL, so other packages do
+//            not see these definitions. The package's own calls bind here
+//            unless a library in the global scope (the C++ runtime of a
+//            program embedding R) defines operator new first; the profile
+//            checks which case holds when it is created.
+//   Windows  every DLL links its own operator new; only the package uses
+//            these.
+//   macOS    dyld coalesces weak definitions such as operator new across all
+//            loaded images, so a replacement here would serve every library
+//            in the R process, and point them into unmapped code once the
+//            package is unloaded. The replacements are never compiled there.
+//
+// Outside a counting window, blocks go straight to malloc / free. Inside one,
+// a block gets a header with its size, the window it was allocated in and a
+// tag, so that only frees of blocks allocated in the current window are
+// counted. The tag sits where a glibc chunk keeps its size (bit 3 of a 64-bit
+// chunk size is always clear), which tells blocks from this library apart from
+// blocks the C++ runtime allocated and this library frees.
+
+static atomic<int> counting(0);
+static atomic<long long> window(0);
+static atomic<long long> n_alloc(0), n_free(0), bytes_alloc(0), bytes_free(0), peak_live(0);
+
+static inline void raisePeak(long long v) {
+    long long cur = peak_live.load(memory_order_relaxed);
+    while(v > cur && !peak_live.compare_exchange_weak(cur, v, memory_order_relaxed)) {}
+}
+
+#if defined(EPR_COUNT_ALLOC) && !defined(__APPLE__)
+
+// Profile bookkeeping of this thread is not counted (AllocPause)
+static thread_local int paused = 0;
+
+struct BlockHeader {
+    long long bytes;
+    long long window;
+    long long unused;
+    unsigned long long tag;
+};
+static const unsigned long long BLOCK_TAG = 0xE9A5C0DE5A11C0C8ULL;
+
+static inline BlockHeader* headerOf(void* p) {
+    return (BlockHeader*)p - 1;
+}
+
+static inline void* countedAlloc(size_t n) {
+    if(counting.load(memory_order_relaxed) == 0 || paused > 0) {
+        return malloc(n > 0 ? n : 1);
+    }
+    BlockHeader* h = (BlockHeader*)malloc(sizeof(BlockHeader) + n);
+    if(!h) return 0;
+    h->bytes = (long long)n;
+    h->window = window.load(memory_order_relaxed);
+    h->tag = BLOCK_TAG;
+    n_alloc.fetch_add(1, memory_order_relaxed);
+    long long total = bytes_alloc.fetch_add(h->bytes, memory_order_relaxed) + h->bytes;
+    raisePeak(total - bytes_free.load(memory_order_relaxed));
+    return h + 1;
+}
+
+static inline void countedFree(void* p) {
+    if(!p) return;
+    BlockHeader* h = headerOf(p);
+    if(h->tag != BLOCK_TAG) {
+        free(p);
+        return;
+    }
+    if(counting.load(memory_order_relaxed) > 0 &&
+       h->window == window.load(memory_order_relaxed)) {
+        n_free.fetch_add(1, memory_order_relaxed);
+        bytes_free.fetch_add(h->bytes, memory_order_relaxed);
+    }
+    h->tag = 0;
+    free(h);
+}
+
+void* operator new(size_t n) {
+    void* p = countedAlloc(n);
+    if(!p) throw bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t n) {
+    void* p = countedAlloc(n);
+    if(!p) throw bad_alloc();
+    return p;
+}
+
+void* operator new(size_t n, const nothrow_t&) noexcept { return countedAlloc(n); }
+void* operator new[](size_t n, const nothrow_t&) noexcept { return countedAlloc(n); }
+
+void operator delete(void* p) noexcept { countedFree(p); }
+void operator delete[](void* p) noexcept { countedFree(p); }
+void operator delete(void* p, const nothrow_t&) noexcept { countedFree(p); }
+void operator delete[](void* p, const nothrow_t&) noexcept { countedFree(p); }
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void* p, size_t) noexcept { countedFree(p); }
+void operator delete[](void* p, size_t) noexcept { countedFree(p); }
+#endif
+
+void allocPauseStart() { paused++; }
+void allocPauseStop() { paused--; }
+
+#else
+
+void allocPauseStart() {}
+void allocPauseStop() {}
+
+#endif
+
+// ==============================================================================
+// COUNTER ACCESS
+// ==============================================================================
+
+// A new window starts when the first profile becomes active
+void allocCountingStart() {
+    if(counting.load() == 0) window.fetch_add(1);
+    counting.fetch_add(1);
+}
+void allocCountingStop() { counting.fetch_sub(1); }
+
+AllocCounts allocCounts() {
+    AllocCounts c;
+    c.allocations = n_alloc.load(memory_order_relaxed);
+    c.frees = n_free.load(memory_order_relaxed);
+    c.bytes = bytes_alloc.load(memory_order_relaxed);
+    c.freed = bytes_free.load(memory_order_relaxed);
+    c.peak = peak_live.load(memory_order_relaxed);
+    return c;
+}
+
+long long allocResetPeak() {
+    long long live = bytes_alloc.load(memory_order_relaxed) - bytes_free.load(memory_order_relaxed);
+    return peak_live.exchange(live, memory_order_relaxed);
+}
+
+void allocRaisePeak(long long v) { raisePeak(v); }
@@ -0,0 +1,258 @@
+#ifndef EMPIRICALPATTERNR_MEMORYPROFILE_H
+#define EMPIRICALPATTERNR_MEMORYPROFILE_H
+
+#include <Rcpp.h>
+#include <chrono>
+#include <new>
+#include <string>
+#include <vector>
+
+// ==============================================================================
+// ALLOCATION AND MEMORY-FOOTPRINT PROFILE
+// ==============================================================================
+// Built with -DEPR_COUNT_ALLOC (see src/Makevars), MemoryProfile.cpp replaces
+// the global operator new / delete of the package library with malloc / free
+// plus counters (not on macOS; see there). The counters only move while at
+// least one profile is active (allocCountingStart), so outside a profile an
+// allocation costs one relaxed atomic load. Sizes are the requested sizes.
+// Frees are counted only for blocks allocated since the first active profile
+// started, and the profile's own bookkeeping is not counted (AllocPause).
+// Memory R allocates for R objects (NumericVector, ...) does not go through
+// operator new and is not counted; callers add it as a footprint entry
+// instead.
+//
+// Counts cover every thread of the process that allocates through the
+// package library. MemoryProfile splits them by phase (sequential sections
+// of a run; peak live bytes above the start of the phase) and by kernel
+// (calls bracketed with enter() / leave() on one thread: allocations, bytes
+// kept after the call and the peak reached by its data plus its scratch
+// space). Kernels that run on several threads at once cannot be told apart
+// by the counters; their callers time them and report them with timed().
+// Only one profile should be active at a time.
+//
+// A profile checks on creation that an allocation made from its caller's
+// translation unit is counted. Where it is not (a default build, macOS, or
+// an operator new that binds elsewhere), counting() is false and the
+// allocation columns of the result are NA; times and footprints are still
+// reported.
+
+struct AllocCounts {
+    long long allocations, frees;
+    long long bytes, freed;      // allocated and freed so far
+    long long peak;              // highest bytes - freed since allocResetPeak()
+    long long live() const { return bytes - freed; }
+};
+
+void allocCountingStart();
+void allocCountingStop();
+AllocCounts allocCounts();
+// Peak back to the current live bytes; returns the previous peak
+long long allocResetPeak();
+// Peak at least v
+void allocRaisePeak(long long v);
+// Allocations of the calling thread are not counted between start and stop
+void allocPauseStart();
+void allocPauseStop();
+
+struct AllocPause {
+    AllocPause() { allocPauseStart(); }
+    ~AllocPause() { allocPauseStop(); }
+};
+
+// Bytes reserved by a vector
+template <class T>
+inline double vectorBytes(const std::vector<T>& v) {
+    return (double)v.capacity() * sizeof(T);
+}
+
+class MemoryProfile {
+public:
+    explicit MemoryProfile(bool enabled) : enabled_(enabled), counting_(false), current_(-1) {
+        if(enabled_) {
+            allocCountingStart();
+            counting_ = probe();
+        }
+    }
+    ~MemoryProfile() {
+        if(enabled_) allocCountingStop();
+    }
+
+    bool enabled() const { return enabled_; }
+    // Allocations are counted (see above)
+    bool counting() const { return counting_; }
+
+    // End the current phase (if any) and start `name`
+    void phase(const char* name) {
+        if(!enabled_) return;
+        endPhase();
+        AllocPause pause;
+        phases_.push_back(Phase());
+        current_ = (int)phases_.size() - 1;
+        Phase& ph = phases_.back();
+        ph.name = name;
+        allocResetPeak();
+        ph.start = allocCounts();
+        ph.t0 = Clock::now();
+    }
+
+    void endPhase() {
+        if(!enabled_ || current_ < 0) return;
+        Phase& ph = phases_[current_];
+        AllocCounts c = allocCounts();
+        ph.seconds = Seconds(Clock::now() - ph.t0).count();
+        ph.allocations = c.allocations - ph.start.allocations;
+        ph.frees = c.frees - ph.start.frees;
+        ph.bytes = c.bytes - ph.start.bytes;
+        ph.peak = c.peak - ph.start.live();
+        current_ = -1;
+    }
+
+    // Register a kernel before the loop that calls it; returns its id
+    int kernel(const char* name) {
+        if(!enabled_) return -1;
+        AllocPause pause;
+        kernels_.push_back(Kernel());
+        kernels_.back().name = name;
+        return (int)kernels_.size() - 1;
+    }
+
+    // Bracket one call of kernel k
+    void enter(int k) {
+        if(!enabled_) return;
+        (void)k;
+        saved_peak_ = allocResetPeak();
+        k_start_ = allocCounts();
+        k_t0_ = Clock::now();
+    }
+
+    void leave(int k) {
+        if(!enabled_) return;
+        Clock::time_point t1 = Clock::now();
+        AllocCounts c = allocCounts();
+        Kernel& kn = kernels_[k];
+        kn.calls++;
+        kn.seconds += Seconds(t1 - k_t0_).count();
+        kn.allocations += c.allocations - k_start_.allocations;
+        kn.bytes += c.bytes - k_start_.bytes;
+        long long top = kn.held + (c.peak - k_start_.live());
+        if(top > kn.peak) kn.peak = top;
+        kn.held += c.live() - k_start_.live();
+        allocRaisePeak(saved_peak_);
+    }
+
+    // Add calls and seconds of kernel k measured by the caller; its
+    // allocation columns are NA
+    void timed(int k, long long calls, double seconds) {
+        if(!enabled_) return;
+        Kernel& kn = kernels_[k];
+        kn.calls += calls;
+        kn.seconds += seconds;
+        kn.timed_only = true;
+    }
+
+    long long held(int k) const { return enabled_ && k >= 0 ? kernels_[k].held : 0; }
+    long long peak(int k) const { return enabled_ && k >= 0 ? kernels_[k].peak : 0; }
+
+    // Bytes held by a named structure; the largest value recorded is kept
+    void footprint(const char* name, double bytes) {
+        if(!enabled_) return;
+        AllocPause pause;
+        for(size_t i = 0; i < footprint_name_.size(); i++) {
+            if(footprint_name_[i] == name) {
+                if(bytes > footprint_[i]) footprint_[i] = bytes;
+                return;
+            }
+        }
+        footprint_name_.push_back(name);
+        footprint_.push_back(bytes);
+    }
+
+    // list(phases, kernels, footprint); R_NilValue when disabled
+    SEXP result() {
+        if(!enabled_) return R_NilValue;
+        endPhase();
+        AllocPause pause;
+        int np = phases_.size(), nk = kernels_.size();
+        Rcpp::CharacterVector p_name(np), k_name(nk);
+        Rcpp::NumericVector p_sec(np), p_alloc(np), p_free(np), p_bytes(np), p_peak(np);
+        Rcpp::NumericVector k_calls(nk), k_sec(nk), k_alloc(nk), k_bytes(nk), k_held(nk),
+                            k_peak(nk);
+        for(int i = 0; i < np; i++) {
+            p_name[i] = phases_[i].name;
+            p_sec[i] = phases_[i].seconds;
+            p_alloc[i] = counted((double)phases_[i].allocations);
+            p_free[i] = counted((double)phases_[i].frees);
+            p_bytes[i] = counted((double)phases_[i].bytes);
+            p_peak[i] = counted((double)phases_[i].peak);
+        }
+        for(int k = 0; k < nk; k++) {
+            const Kernel& kn = kernels_[k];
+            k_name[k] = kn.name;
+            k_calls[k] = (double)kn.calls;
+            k_sec[k] = kn.seconds;
+            k_alloc[k] = kn.timed_only ? NA_REAL : counted((double)kn.allocations);
+            k_bytes[k] = kn.timed_only ? NA_REAL : counted((double)kn.bytes);
+            k_held[k] = kn.timed_only ? NA_REAL : counted((double)kn.held);
+            k_peak[k] = kn.timed_only ? NA_REAL : counted((double)kn.peak);
+        }
+        Rcpp::NumericVector fp(footprint_.begin(), footprint_.end());
+        fp.names() = Rcpp::CharacterVector(footprint_name_.begin(), footprint_name_.end());
+        using Rcpp::Named;
+        return Rcpp::List::create(
+            Named("phases") = Rcpp::List::create(
+                Named("phase") = p_name, Named("seconds") = p_sec,
+                Named("allocations") = p_alloc, Named("frees") = p_free,
+                Named("bytes") = p_bytes, Named("peak_bytes") = p_peak),
+            Named("kernels") = Rcpp::List::create(
+                Named("kernel") = k_name, Named("calls") = k_calls,
+                Named("seconds") = k_sec, Named("allocations") = k_alloc,
+                Named("bytes") = k_bytes, Named("held_bytes") = k_held,
+                Named("peak_bytes") = k_peak),
+            Named("footprint") = fp,
+            Named("counting") = counting_);
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+    typedef std::chrono::duration<double> Seconds;
+
+    struct Phase {
+        std::string name;
+        AllocCounts start;
+        Clock::time_point t0;
+        double seconds;
+        long long allocations, frees, bytes, peak;
+        Phase() : seconds(0), allocations(0), frees(0), bytes(0), peak(0) {}
+    };
+    struct Kernel {
+        std::string name;
+        long long calls, allocations, bytes, held, peak;
+        double seconds;
+        bool timed_only;
+        Kernel() : calls(0), allocations(0), bytes(0), held(0), peak(0), seconds(0),
+                   timed_only(false) {}
+    };
+
+    bool enabled_, counting_;
+    int current_;
+    std::vector<Phase> phases_;
+    std::vector<Kernel> kernels_;
+    std::vector<std::string> footprint_name_;
+    std::vector<double> footprint_;
+    AllocCounts k_start_;
+    long long saved_peak_;
+    Clock::time_point k_t0_;
+
+    double counted(double v) const { return counting_ ? v : NA_REAL; }
+
+    // One allocation through operator new as seen from the including
+    // translation unit, which reaches it the way the rest of the package does
+    static bool probe() {
+        long long before = allocCounts().allocations;
+        void* volatile p = ::operator new(1);
+        ::operator delete(p);
+        return allocCounts().allocations > before;
+    }
+};
+
+#endif
@@ -0,0 +1,200 @@
+#include <Rcpp.h>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "SpatialIndex.h"
+#include "CanopyCover.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace Rcpp;
+using namespace std;
+
+// ==============================================================================
+// TASK-PARALLEL STAND METRICS
+// ==============================================================================
+// A full metric evaluation runs Clark-Evans R, canopy cover, nurse-tree
+// distances and the summary statistics one after another, although they share
+// only read access to the stand. For mid-size stands none of these kernels
+// fills the machine on its own, so here each becomes an OpenMP task: cover and
+// the summary sums are single tasks, while the nearest-neighbour scans for CE
+// (kd-tree) and for the nurse distances (cell grid of the nurses) are split
+// into chunks of trees that idle threads pick up. All tasks join at the end of the parallel region, before the caller
+// evaluates the energy.
+//
+// Chunk results are kept separately and summed in chunk order, so the metrics
+// do not depend on the thread count or on which thread ran which task.
+
+static const int METRIC_CHUNK = 256;
+
+// [[Rcpp::plugins(openmp)]]
+// [[Rcpp::export]]
+List calcStandMetricsTasksCpp(NumericVector x, NumericVector y, NumericVector crown_radius,
+                              NumericVector dbh, NumericVector height,
+                              NumericVector crown_area, NumericVector crown_length,
+                              NumericVector fuel, IntegerVector species, int n_species,
+                              IntegerVector nurse_group, double plot_size = 100.0,
+                              double grid_res = 0.5, int n_threads = 0) {
+    int n = x.size();
+    if(y.size() != n || crown_radius.size() != n || dbh.size() != n ||
+       height.size() != n || crown_area.size() != n || crown_length.size() != n ||
+       fuel.size() != n || species.size() != n || nurse_group.size() != n) {
+        stop("all tree vectors must have the same length");
+    }
+    const double *px = x.begin(), *py = y.begin(), *pr = crown_radius.begin();
+    const double *pd = dbh.begin(), *ph = height.begin();
+    const double *pa = crown_area.begin(), *pl = crown_length.begin(), *pf = fuel.begin();
+    const int *psp = species.begin(), *png = nurse_group.begin();
+
+    // Nurse groups: 1 = nurse-seeking (PIED), 2 = nurse (junipers)
+    vector<int> seekers;
+    vector<double> nurse_x, nurse_y;
+    for(int i = 0; i < n; i++) {
+        if(png[i] == 1) seekers.push_back(i);
+        else if(png[i] == 2) {
+            nurse_x.push_back(px[i]);
+            nurse_y.push_back(py[i]);
+        }
+    }
+    int n_seek = (int)seekers.size(), n_nurse = (int)nurse_x.size();
+
+    int ce_chunks = (n + METRIC_CHUNK - 1) / METRIC_CHUNK;
+    int nurse_chunks = n_nurse > 0 ? (n_seek + METRIC_CHUNK - 1) / METRIC_CHUNK : 0;
+    vector<double> ce_part(ce_chunks, 0.0), nurse_part(nurse_chunks, 0.0);
+
+    double cover = 0.0;
+    double sum_dbh = 0.0, ss_dbh = 0.0, sum_h = 0.0, ss_h = 0.0;
+    double canopy_volume = 0.0, sum_fuel = 0.0, sum_length = 0.0;
+    int n_length = 0;
+    vector<double> counts(max(n_species, 0), 0.0);
+    TorusKDTree* tree = NULL;
+    TorusGrid* nurses = NULL;
+
+    #ifdef _OPENMP
+    if(n_threads > 0) {
+        omp_set_num_threads(n_threads);
+    }
+    #pragma omp parallel
+    #pragma omp single
+    #endif
+    {
+        // Canopy cover raster
+        #ifdef _OPENMP
+        #pragma omp task shared(cover)
+        #endif
+        cover = canopyCoverFraction(px, py, pr, n, plot_size, grid_res);
+
+        // Summary sums (two-pass SDs as in R's sd())
+        #ifdef _OPENMP
+        #pragma omp task shared(sum_dbh, ss_dbh, sum_h, ss_h, canopy_volume, \
+                                sum_fuel, sum_length, n_length, counts)
+        #endif
+        {
+            for(int i = 0; i < n; i++) {
+                sum_dbh += pd[i];
+                sum_h += ph[i];
+                double v = pa[i] * pl[i];
+                if(!isnan(v)) canopy_volume += v;
+                if(!isnan(pf[i])) sum_fuel += pf[i];
+                if(!isnan(pl[i])) {
+                    sum_length += pl[i];
+                    n_length++;
+                }
+                int s = psp[i] - 1;
+                if(s >= 0 && s < n_species) counts[s] += 1.0;
+            }
+            double mean_dbh = sum_dbh / n, mean_h = sum_h / n;
+            for(int i = 0; i < n; i++) {
+                ss_dbh += (pd[i] - mean_dbh) * (pd[i] - mean_dbh);
+                ss_h += (ph[i] - mean_h) * (ph[i] - mean_h);
+            }
+        }
+
+        // Clark-Evans: build the kd-tree, then scan chunks of trees
+        #ifdef _OPENMP
+        #pragma omp task shared(tree, ce_part)
+        #endif
+        {
+            tree = new TorusKDTree(px, py, n, plot_size, plot_size);
+            for(int c = 0; c < ce_chunks; c++) {
+                #ifdef _OPENMP
+                #pragma omp task firstprivate(c) shared(tree, ce_part)
+                #endif
+                {
+                    int end = min(n, (c + 1) * METRIC_CHUNK);
+                    double d2;
+                    int idx;
+                    for(int i = c * METRIC_CHUNK; i < end; i++) {
+                        // Same dummy distance as calcCE when a tree has no neighbour
+                        int found = tree->knn(px[i], py[i], 1, i, &d2, &idx);
+                        ce_part[c] += found == 1 ? sqrt(d2) : 1000.0;
+                    }
+                }
+            }
+            #ifdef _OPENMP
+            #pragma omp taskwait
+            #endif
+        }
+
+        // Nurse distances: each seeker to its nearest nurse (Euclidean, as in
+        // calc_nurse_tree_energy). Build a grid of the nurses with cells about
+        // their mean spacing, then scan chunks of seekers
+        if(nurse_chunks > 0) {
+            #ifdef _OPENMP
+            #pragma omp task shared(nurses, nurse_part, seekers, nurse_x, nurse_y)
+            #endif
+            {
+                nurses = new TorusGrid(plot_size, plot_size, plot_size / sqrt((double)n_nurse),
+                                       n_nurse, false);
+                for(int j = 0; j < n_nurse; j++) nurses->insert(j, nurse_x[j], nurse_y[j]);
+                for(int c = 0; c < nurse_chunks; c++) {
+                    #ifdef _OPENMP
+                    #pragma omp task firstprivate(c) shared(nurses, nurse_part, seekers)
+                    #endif
+                    {
+                        int end = min(n_seek, (c + 1) * METRIC_CHUNK);
+                        int idx;
+                        for(int k = c * METRIC_CHUNK; k < end; k++) {
+                            int i = seekers[k];
+                            nurse_part[c] += nurses->nearest(px[i], py[i], -1, idx);
+                        }
+                    }
+                }
+                #ifdef _OPENMP
+                #pragma omp taskwait
+                #endif
+            }
+        }
+    }
+    delete tree;
+    delete nurses;
+
+    double d_mean = 0.0;
+    for(int c = 0; c < ce_chunks; c++) d_mean += ce_part[c];
+    d_mean /= n;
+    double clark_evans = d_mean / (0.5 * sqrt(plot_size * plot_size / n));
+
+    double nurse_mean = NA_REAL;
+    if(nurse_chunks > 0) {
+        nurse_mean = 0.0;
+        for(int c = 0; c < nurse_chunks; c++) nurse_mean += nurse_part[c];
+        nurse_mean /= n_seek;
+    }
+
+    NumericVector props(counts.size());
+    for(size_t s = 0; s < counts.size(); s++) props[s] = counts[s] / n;
+
+    return List::create(Named("clark_evans_r") = clark_evans,
+                        Named("mean_dbh") = sum_dbh / n,
+                        Named("sd_dbh") = n > 1 ? sqrt(ss_dbh / (n - 1)) : NA_REAL,
+                        Named("mean_height") = sum_h / n,
+                        Named("sd_height") = n > 1 ? sqrt(ss_h / (n - 1)) : NA_REAL,
+                        Named("species_props") = props,
+                        Named("canopy_cover") = cover,
+                        Named("canopy_volume") = canopy_volume,
+                        Named("fuel_mass") = sum_fuel,
+                        Named("canopy_depth") = n_length > 0 ? sum_length / n_length : 0.0,
+                        Named("nurse_mean_distance") = nurse_mean);
+}
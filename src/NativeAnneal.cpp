@@ -0,0 +1,384 @@
+#include <Rcpp.h>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <EmpiricalPatternR/EnergyTerm.h>
+#include "Allometry.h"
+#include "StandRNG.h"
+#include "RunControl.h"
+#include "MemoryProfile.h"
+#include "StandStore.h"
+
+using namespace Rcpp;
+using namespace std;
+using EmpiricalPatternR::Stand;
+using EmpiricalPatternR::Proposal;
+using EmpiricalPatternR::TreeState;
+using EmpiricalPatternR::EnergyTerm;
+
+// ==============================================================================
+// NATIVE ANNEALER OVER PLUGGABLE ENERGY TERMS
+// ==============================================================================
+// Simulated annealing of tree positions, species and DBH entirely in C++, with
+// the energy supplied as a list of EnergyTerm objects (built-in terms from
+// EnergyTerms.cpp or terms from other packages). Each iteration proposes one
+// change to one tree, re-derives its attributes with the fused allometry
+// kernel, asks every term for its energy change, and commits or rolls back
+// all terms together. The tree count is fixed: the initial stand is drawn at
+// the target density, as in simulate_stand().
+//
+// The best stand is copied out only when a worse move is accepted from it (or
+// at the end), as in simulate_stand(). It is returned as a native stand store
+// (StandStore.h) holding the columns of calc_tree_attributes() but Species,
+// which R views without copying.
+//
+// With n_samples > 0 the chain does not stop when annealing ends (energy below
+// the threshold or max_iterations reached): it continues at the fixed
+// temperature sample_temp (0 = the final annealing temperature) and hands
+// every thin-th stand to on_sample, so one converged chain yields a series of
+// realizations. Sampling also starts after max_iterations without
+// convergence; `converged` tells the caller (anneal_stand_native warns). The
+// energy and term energies of every sampling iteration are kept for
+// autocorrelation diagnostics.
+//
+// The loop polls for Ctrl-C through a RunControl (RunControl.h) and, when
+// interrupted, stops and returns the best stand so far (and the samples and
+// trace drawn so far) with interrupted = TRUE. With progress > 0 a status
+// line is printed every `progress` seconds.
+//
+// With profile = TRUE the run also returns a MemoryProfile (MemoryProfile.h):
+// time, heap allocations and peak bytes of the setup, anneal, sample and
+// output phases, the same per energy term (its init, and its propose /
+// commit / rollback calls), and the footprint of the stand, best-stand and
+// trace arrays (the bytes they reserve) and of each term's structures (its
+// counted peak; NA where allocations are not counted).
+
+// Tagged EnergyTerm behind an external pointer, with a matching API version
+static EnergyTerm* energyTermFromSEXP(SEXP s) {
+    if(TYPEOF(s) != EXTPTRSXP ||
+       R_ExternalPtrTag(s) != Rf_install(EmpiricalPatternR::ENERGY_TERM_TAG)) {
+        stop("energy terms must be created with EmpiricalPatternR::wrapEnergyTerm()");
+    }
+    EnergyTerm* term = (EnergyTerm*)R_ExternalPtrAddr(s);
+    if(term == NULL) stop("energy term pointer is NULL (object saved and reloaded?)");
+    if(term->apiVersion() != EmpiricalPatternR::ENERGY_TERM_API_VERSION) {
+        stop("energy term '%s' was built for API version %d (expected %d)",
+             term->name(), term->apiVersion(), EmpiricalPatternR::ENERGY_TERM_API_VERSION);
+    }
+    return term;
+}
+
+// Standard normal draw (Box-Muller)
+static inline double normalDraw(StandRNG& rng) {
+    double u1 = max(rng.uniform(), 1e-300), u2 = rng.uniform();
+    return sqrt(-2.0 * log(u1)) * cos(6.283185307179586 * u2);
+}
+
+// [[Rcpp::export]]
+List annealStandNativeCpp(NumericVector x, NumericVector y, IntegerVector species,
+                          NumericVector dbh, double plot_size, NumericMatrix allometry,
+                          int cbh_method, int foliage_method, List terms,
+                          NumericVector move_probs, NumericVector species_probs,
+                          double dbh_sd_perturb, int max_iterations,
+                          double initial_temp = 0.01, double cooling_rate = 0.9999,
+                          double energy_threshold = 1e-6, int seed = 1,
+                          int n_samples = 0, int thin = 1, double sample_temp = 0.0,
+                          Nullable<Function> on_sample = R_NilValue,
+                          double progress = 0.0, bool profile = false) {
+    MemoryProfile prof(profile);
+    prof.phase("setup");
+    int n = x.size();
+    int n_species = allometry.nrow();
+    if(n < 1) stop("the stand must have at least one tree");
+    if(y.size() != n || species.size() != n || dbh.size() != n) {
+        stop("x, y, species and dbh must have the same length");
+    }
+    if(allometry.ncol() != ALLOMETRY_N_COEFS) {
+        stop("allometry must have %d columns", ALLOMETRY_N_COEFS);
+    }
+    if(move_probs.size() != 3 || species_probs.size() != n_species) {
+        stop("move_probs must have 3 values and species_probs one per species");
+    }
+    if(n_samples > 0 && (thin < 1 || on_sample.isNull())) {
+        stop("sampling needs thin >= 1 and an on_sample function");
+    }
+
+    vector<AllometryCoefs> coefs(n_species);
+    for(int s = 0; s < n_species; s++) coefs[s].load(allometry.begin(), n_species, s);
+
+    int n_terms = terms.size();
+    vector<EnergyTerm*> term(n_terms);
+    for(int k = 0; k < n_terms; k++) term[k] = energyTermFromSEXP(terms[k]);
+
+    // Stand arrays (owned here, read by the terms)
+    vector<double> sx(x.begin(), x.end()), sy(y.begin(), y.end()), sd(dbh.begin(), dbh.end());
+    vector<double> sh(n), sr(n), sc(n), sf(n);
+    vector<int> ssp(n);
+    for(int i = 0; i < n; i++) {
+        ssp[i] = species[i] - 1;
+        if(ssp[i] < 0 || ssp[i] >= n_species) stop("species codes must be in 1..%d", n_species);
+        TreeSize t = evalAllometry(coefs[ssp[i]], cbh_method, foliage_method, sd[i]);
+        sh[i] = t.height;
+        sr[i] = t.crown_radius;
+        sc[i] = t.crown_base;
+        sf[i] = t.fuel_mass;
+    }
+    Stand stand;
+    stand.n = n;
+    stand.n_species = n_species;
+    stand.plot_size = plot_size;
+    stand.x = sx.data();
+    stand.y = sy.data();
+    stand.dbh = sd.data();
+    stand.height = sh.data();
+    stand.crown_radius = sr.data();
+    stand.crown_base = sc.data();
+    stand.fuel_mass = sf.data();
+    stand.species = ssp.data();
+
+    vector<double> e_term(n_terms), pending(n_terms);
+    vector<int> k_init(n_terms), k_run(n_terms);
+    for(int k = 0; k < n_terms; k++) {
+        k_init[k] = prof.kernel((string(term[k]->name()) + " init").c_str());
+        k_run[k] = prof.kernel(term[k]->name());
+    }
+    double energy = 0.0;
+    for(int k = 0; k < n_terms; k++) {
+        prof.enter(k_init[k]);
+        e_term[k] = term[k]->init(stand);
+        prof.leave(k_init[k]);
+        energy += e_term[k];
+    }
+
+    // Cumulative proposal and species probabilities
+    double p_total = move_probs[0] + move_probs[1] + move_probs[2];
+    double p_move = move_probs[0] / p_total, p_species = p_move + move_probs[1] / p_total;
+    vector<double> sp_cum(n_species);
+    double acc = 0.0;
+    for(int s = 0; s < n_species; s++) sp_cum[s] = (acc += species_probs[s]);
+    for(int s = 0; s < n_species; s++) sp_cum[s] /= acc;
+
+    StandRNG rng((uint64_t)(unsigned int)seed);
+    double temperature = initial_temp, best_energy = energy;
+    vector<double> best_term = e_term;
+    vector<double> bx, by, bd;
+    vector<int> bsp;
+    bool best_is_current = true;
+    long accepted = 0;
+    int iter = 0;
+
+    // Sampling phase: trace of energy and term energies per iteration
+    bool sampling = false, converged = false;
+    long sample_iter = 0, sample_accepted = 0;
+    long n_trace = n_samples > 0 ? (long)n_samples * thin : 0;
+    NumericMatrix trace(n_trace, n_terms + 1);
+    double trace_bytes = (double)trace.size() * sizeof(double);
+
+    RunControl run("anneal", (long)max_iterations + n_trace, progress);
+    run.energy.store(energy);
+    run.best.store(best_energy);
+    prof.phase("anneal");
+
+    while(!run.poll()) {
+        if(!sampling && (iter >= max_iterations || energy < energy_threshold)) {
+            if(n_samples <= 0) break;
+            converged = energy < energy_threshold;
+            sampling = true;
+            if(sample_temp > 0) temperature = sample_temp;
+            prof.phase("sample");
+        }
+        if(sampling && sample_iter == n_trace) break;
+        if(!sampling) iter++;
+
+        Proposal p;
+        double u = rng.uniform();
+        p.type = u < p_move ? EmpiricalPatternR::PROPOSE_MOVE
+               : u < p_species ? EmpiricalPatternR::PROPOSE_SPECIES
+                               : EmpiricalPatternR::PROPOSE_DBH;
+        int i = min(n - 1, (int)(rng.uniform() * n));
+        p.tree = i;
+        TreeState& b = p.before;
+        b.x = sx[i];
+        b.y = sy[i];
+        b.dbh = sd[i];
+        b.height = sh[i];
+        b.crown_radius = sr[i];
+        b.crown_base = sc[i];
+        b.fuel_mass = sf[i];
+        b.species = ssp[i];
+        p.after = b;
+        TreeState& a = p.after;
+        if(p.type == EmpiricalPatternR::PROPOSE_MOVE) {
+            a.x = rng.uniform() * plot_size;
+            a.y = rng.uniform() * plot_size;
+        } else {
+            if(p.type == EmpiricalPatternR::PROPOSE_SPECIES) {
+                double v = rng.uniform();
+                a.species = (int)(lower_bound(sp_cum.begin(), sp_cum.end(), v) - sp_cum.begin());
+                a.species = min(a.species, n_species - 1);
+            } else {
+                a.dbh = max(b.dbh + normalDraw(rng) * dbh_sd_perturb, 5.0);  // Minimum 5cm
+            }
+            TreeSize t = evalAllometry(coefs[a.species], cbh_method, foliage_method, a.dbh);
+            a.height = t.height;
+            a.crown_radius = t.crown_radius;
+            a.crown_base = t.crown_base;
+            a.fuel_mass = t.fuel_mass;
+        }
+
+        double delta = 0.0;
+        for(int k = 0; k < n_terms; k++) {
+            prof.enter(k_run[k]);
+            pending[k] = term[k]->propose(stand, p);
+            prof.leave(k_run[k]);
+            delta += pending[k];
+        }
+
+        bool accept = delta < 0 || rng.uniform() < exp(-delta / temperature);
+        if(accept) {
+            // Leaving the best stand for a worse one: keep a copy of it first.
+            // A move that keeps the energy keeps the current stand the best.
+            if(energy + delta < best_energy) {
+                best_is_current = true;
+            } else if(best_is_current && delta > 0) {
+                bx = sx;
+                by = sy;
+                bd = sd;
+                bsp = ssp;
+                best_is_current = false;
+            }
+            for(int k = 0; k < n_terms; k++) {
+                prof.enter(k_run[k]);
+                term[k]->commit();
+                prof.leave(k_run[k]);
+                e_term[k] += pending[k];
+            }
+            energy += delta;
+            if(best_is_current) {
+                best_energy = energy;
+                best_term = e_term;
+            }
+            sx[i] = a.x;
+            sy[i] = a.y;
+            sd[i] = a.dbh;
+            sh[i] = a.height;
+            sr[i] = a.crown_radius;
+            sc[i] = a.crown_base;
+            sf[i] = a.fuel_mass;
+            ssp[i] = a.species;
+            if(sampling) sample_accepted++;
+            else accepted++;
+            run.accepted.store(accepted + sample_accepted, memory_order_relaxed);
+            run.energy.store(energy, memory_order_relaxed);
+            run.best.store(best_energy, memory_order_relaxed);
+        } else {
+            for(int k = 0; k < n_terms; k++) {
+                prof.enter(k_run[k]);
+                term[k]->rollback();
+                prof.leave(k_run[k]);
+            }
+        }
+        run.done.store(iter + sample_iter + (sampling ? 1 : 0), memory_order_relaxed);
+
+        if(!sampling) {
+            temperature *= cooling_rate;
+            continue;
+        }
+        trace(sample_iter, 0) = energy;
+        for(int k = 0; k < n_terms; k++) trace(sample_iter, k + 1) = e_term[k];
+        sample_iter++;
+        if(sample_iter % thin == 0) {
+            IntegerVector cur_species(n);
+            for(int j = 0; j < n; j++) cur_species[j] = ssp[j] + 1;
+            try {
+                Function(on_sample.get())((int)(sample_iter / thin),
+                                          NumericVector(sx.begin(), sx.end()),
+                                          NumericVector(sy.begin(), sy.end()),
+                                          cur_species, NumericVector(sd.begin(), sd.end()),
+                                          energy);
+            } catch(Rcpp::internal::InterruptedException&) {
+                run.stop();
+            }
+        }
+    }
+    run.finish();
+    prof.phase("output");
+
+    // Interrupted while sampling: keep the trace drawn so far
+    if(sample_iter < n_trace) {
+        NumericMatrix part(sample_iter, n_terms + 1);
+        for(int k = 0; k <= n_terms; k++) {
+            for(long r = 0; r < sample_iter; r++) part(r, k) = trace(r, k);
+        }
+        trace = part;
+    }
+
+    if(best_is_current) {
+        bx = sx;
+        by = sy;
+        bd = sd;
+        bsp = ssp;
+    }
+    IntegerVector out_species(n);
+    for(int j = 0; j < n; j++) out_species[j] = bsp[j] + 1;
+
+    // Best stand and its attributes
+    RObject trees = wrapStandStore(new StandStore());
+    StandStore* best = (StandStore*)R_ExternalPtrAddr(trees);
+    const char* columns[] = {"x", "y", "DBH", "Height", "CrownRadius", "CrownDiameter",
+                             "CrownArea", "CrownBaseHeight", "CrownLength", "CanopyFuelMass"};
+    best->add("Number", StandColumn::INTEGER, n);
+    for(int c = 0; c < 10; c++) best->add(columns[c], StandColumn::REAL, n);
+    int* t_num = best->integer("Number");
+    double *t_x = best->real("x"), *t_y = best->real("y"), *t_d = best->real("DBH");
+    double *t_h = best->real("Height"), *t_r = best->real("CrownRadius");
+    double *t_cd = best->real("CrownDiameter"), *t_ca = best->real("CrownArea");
+    double *t_cb = best->real("CrownBaseHeight"), *t_cl = best->real("CrownLength");
+    double *t_f = best->real("CanopyFuelMass");
+    for(int j = 0; j < n; j++) {
+        TreeSize t = evalAllometry(coefs[bsp[j]], cbh_method, foliage_method, bd[j]);
+        t_num[j] = j + 1;
+        t_x[j] = bx[j];
+        t_y[j] = by[j];
+        t_d[j] = bd[j];
+        t_h[j] = t.height;
+        t_r[j] = t.crown_radius;
+        t_cd[j] = 2.0 * t.crown_radius;
+        t_ca[j] = M_PI * t.crown_radius * t.crown_radius;
+        t_cb[j] = t.crown_base;
+        t_cl[j] = t.height - t.crown_base;
+        t_f[j] = t.fuel_mass;
+    }
+    NumericVector term_energy(n_terms);
+    CharacterVector term_names(n_terms);
+    for(int k = 0; k < n_terms; k++) {
+        term_energy[k] = best_term[k];
+        term_names[k] = term[k]->name();
+    }
+    term_energy.attr("names") = term_names;
+
+    prof.footprint("stand", vectorBytes(sx) + vectorBytes(sy) + vectorBytes(sd) + vectorBytes(sh)
+                            + vectorBytes(sr) + vectorBytes(sc) + vectorBytes(sf) + vectorBytes(ssp));
+    prof.footprint("best", vectorBytes(bx) + vectorBytes(by) + vectorBytes(bd) + vectorBytes(bsp));
+    prof.footprint("trees", best->bytes());
+    prof.footprint("trace", trace_bytes);
+    for(int k = 0; k < n_terms; k++) {
+        prof.footprint(term[k]->name(),
+                       prof.counting() ? (double)max(prof.peak(k_init[k]),
+                                                     prof.held(k_init[k]) + prof.peak(k_run[k]))
+                                       : NA_REAL);
+    }
+
+    return List::create(Named("trees") = trees,
+                        Named("species") = out_species,
+                        Named("energy") = best_energy,
+                        Named("term_energy") = term_energy,
+                        Named("final_energy") = energy,
+                        Named("accepted") = (double)accepted,
+                        Named("iterations") = iter,
+                        Named("converged") = converged || energy < energy_threshold,
+                        Named("sample_accepted") = (double)sample_accepted,
+                        Named("trace") = trace,
+                        Named("interrupted") = run.stopped(),
+                        Named("profile") = prof.result());
+}
@@ -0,0 +1,181 @@
+#include <Rcpp.h>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "SpatialIndex.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace Rcpp;
+using namespace std;
+
+// ==============================================================================
+// K-TH NEAREST NEIGHBOUR DISTANCES AND G-FUNCTION (kd-tree)
+// ==============================================================================
+// One query pass over a toroidal kd-tree gives, for every tree, the distances
+// to its K nearest neighbours. From these we report the mean k-th NN distance
+// for k = 1..K (k = 1 is the Clark-Evans numerator) and the empirical nearest
+// neighbour distribution function G(r) = P(d1 <= r). Higher-order distances
+// separate clustered from regular patterns that share the same CE value.
+
+// [[Rcpp::plugins(openmp)]]
+// [[Rcpp::export]]
+List calcNNStatsCpp(double xmax, double ymax, NumericVector x, NumericVector y,
+                    int k_max, NumericVector r, int n_threads = 0) {
+    int na = x.size();
+    if(k_max < 1) stop("k_max must be at least 1");
+
+    NumericVector mean_nn(k_max);
+    NumericVector G(r.size());
+    if(na < 2) {
+        fill(mean_nn.begin(), mean_nn.end(), NA_REAL);
+        fill(G.begin(), G.end(), NA_REAL);
+        return List::create(Named("mean_nn") = mean_nn,
+                            Named("clark_evans_r") = NA_REAL,
+                            Named("r") = r,
+                            Named("G") = G);
+    }
+
+    TorusKDTree tree(x.begin(), y.begin(), na, xmax, ymax);
+    int k = min(k_max, na - 1);
+
+    // Per-point k-NN distances (row i = point i), filled in parallel
+    vector<double> dist(na * k);
+
+    #ifdef _OPENMP
+    if(n_threads > 0) {
+        omp_set_num_threads(n_threads);
+    }
+    #pragma omp parallel
+    #endif
+    {
+        vector<double> d2(k);
+        vector<int> idx(k);
+
+        #ifdef _OPENMP
+        #pragma omp for schedule(static)
+        #endif
+        for(int i = 0; i < na; i++) {
+            tree.knn(x[i], y[i], k, i, d2.data(), idx.data());
+            for(int j = 0; j < k; j++) {
+                dist[i * k + j] = sqrt(d2[j]);
+            }
+        }
+    }
+
+    for(int j = 0; j < k_max; j++) {
+        if(j >= k) {
+            mean_nn[j] = NA_REAL;  // not enough trees for this order
+            continue;
+        }
+        double s = 0.0;
+        for(int i = 0; i < na; i++) s += dist[i * k + j];
+        mean_nn[j] = s / na;
+    }
+
+    // G(r): proportion of trees whose nearest neighbour lies within r
+    vector<double> d1(na);
+    for(int i = 0; i < na; i++) d1[i] = dist[i * k];
+    sort(d1.begin(), d1.end());
+    for(int ri = 0; ri < r.size(); ri++) {
+        G[ri] = (double)(upper_bound(d1.begin(), d1.end(), r[ri]) - d1.begin()) / na;
+    }
+
+    double d1Poisson = 0.5 * sqrt((xmax * ymax) / na);
+
+    return List::create(Named("mean_nn") = mean_nn,
+                        Named("clark_evans_r") = mean_nn[0] / d1Poisson,
+                        Named("r") = r,
+                        Named("G") = G);
+}
+
+// ==============================================================================
+// PER-SPECIES AND CROSS-TYPE NEAREST NEIGHBOUR INDICES
+// ==============================================================================
+// For species a and b, mean_nn[a, b] is the mean distance from a tree of
+// species a to its nearest tree of species b (excluding itself when a == b).
+// Dividing by the Poisson expectation 0.5 * sqrt(A / n_b) gives the
+// within-species Clark-Evans R on the diagonal and cross-type NN indices off
+// the diagonal (< 1: a-trees sit closer to b-trees than under independence).
+// One kd-tree per species is built once, then a single pass over all trees
+// queries each species tree, instead of a full calcCE call per species.
+// Species are integer codes 1..n_species (R factor codes).
+
+static void speciesIndex(double xmax, double ymax, int n_species,
+                         const vector<double>& sum, const vector<int>& count,
+                         NumericMatrix& mean_nn, NumericMatrix& index) {
+    for(int a = 0; a < n_species; a++) {
+        for(int b = 0; b < n_species; b++) {
+            int nb = count[b];
+            // Need at least one neighbour candidate other than the tree itself
+            bool ok = count[a] > 0 && (a == b ? nb > 1 : nb > 0);
+            if(!ok) {
+                mean_nn(a, b) = NA_REAL;
+                index(a, b) = NA_REAL;
+                continue;
+            }
+            mean_nn(a, b) = sum[a * n_species + b] / count[a];
+            index(a, b) = mean_nn(a, b) / (0.5 * sqrt((xmax * ymax) / nb));
+        }
+    }
+}
+
+// [[Rcpp::plugins(openmp)]]
+// [[Rcpp::export]]
+List calcSpeciesCECpp(double xmax, double ymax, NumericVector x, NumericVector y,
+                      IntegerVector species, int n_species, int n_threads = 0) {
+    int na = x.size();
+    if(n_species < 1) stop("n_species must be at least 1");
+
+    // Gather coordinates by species and build one index per species
+    vector<vector<double> > sx(n_species), sy(n_species);
+    vector<vector<int> > members(n_species);
+    vector<int> local(na);
+    for(int i = 0; i < na; i++) {
+        int s = species[i] - 1;
+        if(s < 0 || s >= n_species) stop("species codes must be in 1..n_species");
+        local[i] = (int)members[s].size();
+        members[s].push_back(i);
+        sx[s].push_back(x[i]);
+        sy[s].push_back(y[i]);
+    }
+    vector<TorusKDTree> trees;
+    trees.reserve(n_species);
+    vector<int> count(n_species);
+    for(int s = 0; s < n_species; s++) {
+        count[s] = (int)members[s].size();
+        trees.push_back(TorusKDTree(sx[s].data(), sy[s].data(), count[s], xmax, ymax));
+    }
+
+    // Single pass: nearest tree of every species for every tree
+    vector<double> nn(na * n_species);
+
+    #ifdef _OPENMP
+    if(n_threads > 0) {
+        omp_set_num_threads(n_threads);
+    }
+    #pragma omp parallel for schedule(static)
+    #endif
+    for(int i = 0; i < na; i++) {
+        int a = species[i] - 1;
+        for(int b = 0; b < n_species; b++) {
+            int self = (a == b) ? local[i] : -1;
+            nn[i * n_species + b] = sqrt(trees[b].nearest2(x[i], y[i], self, 0.0));
+        }
+    }
+
+    vector<double> sum(n_species * n_species, 0.0);
+    for(int i = 0; i < na; i++) {
+        int a = species[i] - 1;
+        for(int b = 0; b < n_species; b++) sum[a * n_species + b] += nn[i * n_species + b];
+    }
+
+    NumericMatrix mean_nn(n_species, n_species), index(n_species, n_species);
+    speciesIndex(xmax, ymax, n_species, sum, count, mean_nn, index);
+
+    return List::create(Named("mean_nn") = mean_nn,
+                        Named("index") = index,
+                        Named("n") = wrap(count));
+}
@@ -2,7 +2,7 @@
 #include <cmath>
 #include <vector>
 #include <algorithm>
-#include <queue>
+#include "SpatialIndex.h"
 
 using namespace Rcpp;
 using namespace std;
@@ -16,55 +16,27 @@ double getEuclideanDistance(double xmax, double ymax, double x1, double y1, doub
 	return dz;
 }
 
-// Improved nearest neighbor search using priority queues for better performance
+// Mean distance to the mi-th nearest neighbour using a toroidal kd-tree
+// (O(n log n) instead of the former all-pairs priority-queue scan)
 double findNeighbours(double xmax, double ymax, NumericVector x, NumericVector y, int mi) {
     int na = x.size();
-    
+
     // Large dummy value for initialization (larger than any expected distance in plot)
     const double DUMMY_LARGE_DISTANCE = 1000.0;
-    
-    // Use vectors instead of VLA for better memory management
-    // We need mi+1 slots to track the mi nearest neighbors (excluding self at distance 0)
-    vector<priority_queue<double, vector<double>, less<double>>> distances(na);
-    
-    // Initialize each priority queue to track mi+1 nearest neighbors
-    for(int i = 0; i < na; i++) {
-        // Add dummy large values to ensure we always have something to compare
-        for(int j = 0; j <= mi; j++) {
-            distances[i].push(DUMMY_LARGE_DISTANCE);
-        }
-    }
-    
-    // Calculate all pairwise distances (optimized loop)
-    for(int i = 0; i < na - 1; i++) {
-        for(int j = i + 1; j < na; j++) {
-            double d = getEuclideanDistance(xmax, ymax, x[i], y[i], x[j], y[j]);
-            
-            // Update distances for point i
-            if(d < distances[i].top()) {
-                distances[i].pop();
-                distances[i].push(d);
-            }
-            
-            // Update distances for point j
-            if(d < distances[j].top()) {
-                distances[j].pop();
-                distances[j].push(d);
-            }
-        }
-    }
-    
+
+    TorusKDTree tree(x.begin(), y.begin(), na, xmax, ymax);
+    vector<double> d2(mi);
+    vector<int> idx(mi);
+
     // Calculate mean nearest neighbor distance (mi-th nearest, which is index mi counting from 1)
     double d1 = 0;
     for(int i = 0; i < na; i++) {
-        // Pop off the furthest neighbor to get to the mi-th nearest
-        distances[i].pop();
-        if(!distances[i].empty()) {
-            d1 += distances[i].top();
-        }
+        int found = tree.knn(x[i], y[i], mi, i, d2.data(), idx.data());
+        // Fewer than mi other trees: keep the dummy distance as before
+        d1 += (found == mi) ? sqrt(d2[mi - 1]) : DUMMY_LARGE_DISTANCE;
     }
     d1 /= na;
-    
+
     return d1;
 }
 
@@ -2,6 +2,7 @@
 #include <cmath>
 #include <vector>
 #include <algorithm>
+#include "CanopyCover.h"
 
 using namespace Rcpp;
 using namespace std;
@@ -17,50 +18,35 @@ double calcCanopyCoverCpp(NumericVector x, NumericVector y,
                          NumericVector crown_radius, 
                          double plot_size = 100.0, 
                          double grid_res = 0.5) {
-    
-    int n_trees = x.size();
-    int n_cells = ceil(plot_size / grid_res);
-    
-    // Use vector<bool> for memory efficiency (1 bit per cell)
-    vector<bool> grid(n_cells * n_cells, false);
-    
-    // For each tree, mark covered cells
-    for(int i = 0; i < n_trees; i++) {
-        double radius = crown_radius[i];
-        double radius_sq = radius * radius;  // Pre-compute for speed
-        
-        // Calculate bounding box
-        int x_min = max(0, (int)floor((x[i] - radius) / grid_res));
-        int x_max = min(n_cells - 1, (int)ceil((x[i] + radius) / grid_res));
-        int y_min = max(0, (int)floor((y[i] - radius) / grid_res));
-        int y_max = min(n_cells - 1, (int)ceil((y[i] + radius) / grid_res));
-        
-        // Check cells in bounding box
-        for(int xi = x_min; xi <= x_max; xi++) {
-            double cell_x = (xi + 0.5) * grid_res;
-            double dx = cell_x - x[i];
-            double dx_sq = dx * dx;
-            
-            for(int yi = y_min; yi <= y_max; yi++) {
-                double cell_y = (yi + 0.5) * grid_res;
-                double dy = cell_y - y[i];
-                
-                // Fast distance check (squared distance avoids sqrt)
-                if(dx_sq + dy * dy <= radius_sq) {
-                    grid[yi * n_cells + xi] = true;
-                }
-            }
-        }
-    }
-    
-    // Count covered cells
-    int covered = 0;
-    for(int i = 0; i < n_cells * n_cells; i++) {
-        if(grid[i]) covered++;
-    }
-    
-    // Return proportion
-    return (double)covered / (n_cells * n_cells);
+    return canopyCoverFraction(x.begin(), y.begin(), crown_radius.begin(),
+                               x.size(), plot_size, grid_res);
+}
+
+// Elliptical crowns: semi-axes a (along angle, radians) and b, centred at
+// (x + offset_x, y + offset_y). With a == b and zero offsets this matches
+// calcCanopyCoverCpp cell for cell.
+// [[Rcpp::export]]
+double calcCanopyCoverEllipseCpp(NumericVector x, NumericVector y,
+                                 NumericVector semi_a, NumericVector semi_b,
+                                 NumericVector angle, NumericVector offset_x,
+                                 NumericVector offset_y,
+                                 double plot_size = 100.0,
+                                 double grid_res = 0.5) {
+    EllipseCrowns crowns(x.begin(), y.begin(), semi_a.begin(), semi_b.begin(),
+                         angle.begin(), offset_x.begin(), offset_y.begin(),
+                         x.size());
+    return crownCoverFraction(crowns, plot_size, grid_res);
+}
+
+// Cover from per-row chord intervals (IntervalCover): exact in x, rows every
+// row_res in y; memory grows with crown count rather than plot area
+// [[Rcpp::export]]
+double calcCanopyCoverIntervalCpp(NumericVector x, NumericVector y,
+                                  NumericVector crown_radius,
+                                  double plot_size = 100.0,
+                                  double row_res = 0.5) {
+    CircleCrowns crowns(x.begin(), y.begin(), crown_radius.begin(), x.size());
+    return intervalCoverFraction(crowns, plot_size, row_res);
 }
 
 // ==============================================================================
@@ -221,6 +207,20 @@ double calcCrownOverlapCpp(NumericVector x, NumericVector y,
     return total_overlap;
 }
 
+// Raster approximation of the same quantity for elliptical, offset crowns
+// (see crownOverlapArea in CanopyCover.h)
+// [[Rcpp::export]]
+double calcCrownOverlapEllipseCpp(NumericVector x, NumericVector y,
+                                  NumericVector semi_a, NumericVector semi_b,
+                                  NumericVector angle, NumericVector offset_x,
+                                  NumericVector offset_y,
+                                  double grid_res = 0.1) {
+    EllipseCrowns crowns(x.begin(), y.begin(), semi_a.begin(), semi_b.begin(),
+                         angle.begin(), offset_x.begin(), offset_y.begin(),
+                         x.size());
+    return crownOverlapArea(crowns, grid_res);
+}
+
 // ==============================================================================
 // VECTORIZED DBH AND HEIGHT DISTRIBUTION CALCULATIONS
 // ==============================================================================
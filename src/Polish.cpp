@@ -0,0 +1,483 @@
+#include <Rcpp.h>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "SpatialIndex.h"
+#include "CanopyCover.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace Rcpp;
+using namespace std;
+
+// ==============================================================================
+// CONTINUOUS POLISHING (L-BFGS ON A SMOOTH SURROGATE ENERGY)
+// ==============================================================================
+// Once annealing has settled the discrete structure (tree count, species), the
+// remaining error is in continuous coordinates and DBH, which random moves
+// fine-tune slowly. Here x, y and DBH are optimized jointly with projected
+// L-BFGS on a differentiable stand-in for calc_energy():
+//   - canopy cover: crowns with a logistic edge of width edge_width, combined
+//     per raster cell as 1 - prod(1 - s_i) on the calc_canopy_cover grid
+//   - Clark-Evans R: mean soft-min (temperature nn_temperature) over the k
+//     nearest toroidal neighbours from the kd-tree
+//   - size moments and CFL: exact, through piecewise-linear allometry tables
+// Each round recalibrates the surrogate against the exact CE and cover so the
+// optimum of the surrogate is pulled onto the exact targets.
+//
+// Metric order of `target` and `weight`: ce, mean_dbh, sd_dbh, mean_height,
+// sd_height, canopy_cover, cfl. Relative errors match calc_energy().
+
+enum { P_CE = 0, P_DBH_MEAN, P_DBH_SD, P_H_MEAN, P_H_SD, P_COVER, P_CFL, P_N };
+
+struct PolishProblem {
+    int n, n_species, n_grid, k_nn, n_cells;
+    const int* species;                       // 0-based species codes
+    double grid_min, grid_step;
+    const double* h_tab;                      // n_grid x n_species, column-major
+    const double* r_tab;
+    const double* f_tab;
+    double plot_size, grid_res, tau, temp, dbh_min;
+    double target[P_N], weight[P_N];
+    double ce_offset, cover_offset;           // surrogate minus exact, per round
+
+    // Per-evaluation scratch
+    vector<double> h, dh, r, dr, f, df, logq;
+
+    // Linear interpolation in an allometry table (extrapolates at the ends)
+    inline void lookup(const double* tab, int sp, double d, double& val, double& slope) const {
+        double u = (d - grid_min) / grid_step;
+        int j = (int)floor(u);
+        j = max(0, min(n_grid - 2, j));
+        const double* col = tab + (size_t)sp * n_grid;
+        slope = (col[j + 1] - col[j]) / grid_step;
+        val = col[j] + (u - j) * (col[j + 1] - col[j]);
+    }
+
+    void allometry(const double* d) {
+        h.resize(n); dh.resize(n); r.resize(n); dr.resize(n); f.resize(n); df.resize(n);
+        for(int i = 0; i < n; i++) {
+            lookup(h_tab, species[i], d[i], h[i], dh[i]);
+            lookup(r_tab, species[i], d[i], r[i], dr[i]);
+            lookup(f_tab, species[i], d[i], f[i], df[i]);
+        }
+    }
+
+    // Soft canopy cover and its gradient w.r.t. x, y and crown radius
+    double softCover(const double* x, const double* y, double* gx, double* gy, double* gr) {
+        logq.assign((size_t)n_cells * n_cells, 0.0);
+        double reach = 4.0 * tau;
+
+        // Pass 1: log prod(1 - s_i) per cell
+        for(int i = 0; i < n; i++) {
+            int cx0, cx1, cy0, cy1;
+            cellRange(x[i], y[i], r[i] + reach, cx0, cx1, cy0, cy1);
+            for(int cy = cy0; cy <= cy1; cy++) {
+                double py = (cy + 0.5) * grid_res;
+                for(int cx = cx0; cx <= cx1; cx++) {
+                    double px = (cx + 0.5) * grid_res;
+                    double dist = sqrt((px - x[i]) * (px - x[i]) + (py - y[i]) * (py - y[i]));
+                    double s = 1.0 / (1.0 + exp(-(r[i] - dist) / tau));
+                    logq[(size_t)cy * n_cells + cx] += log(max(1.0 - s, 1e-12));
+                }
+            }
+        }
+
+        double covered = 0.0;
+        for(size_t k = 0; k < logq.size(); k++) covered += 1.0 - exp(logq[k]);
+        double scale = 1.0 / ((double)n_cells * n_cells);
+
+        // Pass 2: each tree only writes its own gradient entries
+        #ifdef _OPENMP
+        #pragma omp parallel for schedule(dynamic, 16)
+        #endif
+        for(int i = 0; i < n; i++) {
+            int cx0, cx1, cy0, cy1;
+            cellRange(x[i], y[i], r[i] + reach, cx0, cx1, cy0, cy1);
+            double sx = 0, sy = 0, sr = 0;
+            for(int cy = cy0; cy <= cy1; cy++) {
+                double py = (cy + 0.5) * grid_res;
+                for(int cx = cx0; cx <= cx1; cx++) {
+                    double px = (cx + 0.5) * grid_res;
+                    double ddx = px - x[i], ddy = py - y[i];
+                    double dist = sqrt(ddx * ddx + ddy * ddy);
+                    double s = 1.0 / (1.0 + exp(-(r[i] - dist) / tau));
+                    double q = max(1.0 - s, 1e-12);
+                    // d(1 - prod q)/ds_i = prod_{j != i} q_j
+                    double others = exp(logq[(size_t)cy * n_cells + cx] - log(q));
+                    double dz = others * s * (1.0 - s) / tau;
+                    sr += dz;
+                    if(dist > 1e-12) {
+                        sx += dz * ddx / dist;
+                        sy += dz * ddy / dist;
+                    }
+                }
+            }
+            gx[i] = sx * scale;
+            gy[i] = sy * scale;
+            gr[i] = sr * scale;
+        }
+        return covered * scale;
+    }
+
+    inline void cellRange(double x, double y, double reach,
+                          int& cx0, int& cx1, int& cy0, int& cy1) const {
+        cx0 = max(0, (int)floor((x - reach) / grid_res));
+        cx1 = min(n_cells - 1, (int)floor((x + reach) / grid_res));
+        cy0 = max(0, (int)floor((y - reach) / grid_res));
+        cy1 = min(n_cells - 1, (int)floor((y + reach) / grid_res));
+    }
+
+    // Soft-min Clark-Evans R and its gradient w.r.t. x, y (accumulated)
+    double softCE(const double* x, const double* y, double* gx, double* gy) {
+        if(n < 2) return 0.0;
+        double d_pois = 0.5 * sqrt(plot_size * plot_size / n);
+        int k = min(k_nn, n - 1);
+        TorusKDTree tree(x, y, n, plot_size, plot_size);
+        vector<double> d2(k), w(k);
+        vector<int> idx(k);
+
+        double total = 0.0;
+        double c = 1.0 / (n * d_pois);
+        for(int i = 0; i < n; i++) {
+            int found = tree.knn(x[i], y[i], k, i, d2.data(), idx.data());
+            double dmin = sqrt(d2[0]);
+            double S = 0.0;
+            for(int m = 0; m < found; m++) {
+                w[m] = exp(-(sqrt(d2[m]) - dmin) / temp);
+                S += w[m];
+            }
+            total += dmin - temp * log(S);
+            for(int m = 0; m < found; m++) {
+                double d = sqrt(d2[m]);
+                if(d < 1e-12) continue;
+                int j = idx[m];
+                double dx = wrap(x[i] - x[j]), dy = wrap(y[i] - y[j]);
+                double g = c * w[m] / S / d;
+                gx[i] += g * dx; gy[i] += g * dy;
+                gx[j] -= g * dx; gy[j] -= g * dy;
+            }
+        }
+        return total * c;
+    }
+
+    inline double wrap(double d) const {
+        if(d > 0.5 * plot_size) d -= plot_size;
+        else if(d < -0.5 * plot_size) d += plot_size;
+        return d;
+    }
+
+    // Exact CE and cover (same kernels as calcCE / calc_canopy_cover)
+    void exactMetrics(const double* v, double& ce, double& cover) {
+        const double* x = v;
+        const double* y = v + n;
+        allometry(v + 2 * n);
+        cover = canopyCoverFraction(x, y, r.data(), n, plot_size, grid_res);
+        if(n < 2) { ce = NA_REAL; return; }
+        TorusKDTree tree(x, y, n, plot_size, plot_size);
+        double d1 = 0.0;
+        for(int i = 0; i < n; i++) d1 += sqrt(tree.nearest2(x[i], y[i], i, 0.0));
+        ce = (d1 / n) / (0.5 * sqrt(plot_size * plot_size / n));
+    }
+
+    // Surrogate energy at v = (x, y, dbh); fills the gradient g (length 3n)
+    double evaluate(const double* v, double* g) {
+        const double* x = v;
+        const double* y = v + n;
+        const double* d = v + 2 * n;
+        double* gx = g;
+        double* gy = g + n;
+        double* gd = g + 2 * n;
+        fill(g, g + 3 * n, 0.0);
+        allometry(d);
+
+        double E = 0.0;
+        double area = plot_size * plot_size;
+
+        // Size moments
+        double md = 0, mh = 0;
+        for(int i = 0; i < n; i++) { md += d[i]; mh += h[i]; }
+        md /= n; mh /= n;
+        double vd = 0, vh = 0;
+        for(int i = 0; i < n; i++) {
+            vd += (d[i] - md) * (d[i] - md);
+            vh += (h[i] - mh) * (h[i] - mh);
+        }
+        double sdd = n > 1 ? sqrt(vd / (n - 1)) : 0.0;
+        double sdh = n > 1 ? sqrt(vh / (n - 1)) : 0.0;
+
+        double e_md = (md - target[P_DBH_MEAN]) / target[P_DBH_MEAN];
+        double e_sd = (sdd - target[P_DBH_SD]) / target[P_DBH_MEAN];
+        double e_mh = (mh - target[P_H_MEAN]) / target[P_H_MEAN];
+        double e_sh = (sdh - target[P_H_SD]) / target[P_H_MEAN];
+        E += weight[P_DBH_MEAN] * e_md * e_md + weight[P_DBH_SD] * e_sd * e_sd +
+             weight[P_H_MEAN] * e_mh * e_mh + weight[P_H_SD] * e_sh * e_sh;
+
+        double c_md = 2 * weight[P_DBH_MEAN] * e_md / target[P_DBH_MEAN] / n;
+        double c_sd = sdd > 0 ? 2 * weight[P_DBH_SD] * e_sd / target[P_DBH_MEAN] / ((n - 1) * sdd) : 0.0;
+        double c_mh = 2 * weight[P_H_MEAN] * e_mh / target[P_H_MEAN] / n;
+        double c_sh = sdh > 0 ? 2 * weight[P_H_SD] * e_sh / target[P_H_MEAN] / ((n - 1) * sdh) : 0.0;
+
+        // Canopy fuel load
+        double fuel = 0;
+        for(int i = 0; i < n; i++) fuel += f[i];
+        double e_cfl = (fuel / area - target[P_CFL]) / target[P_CFL];
+        E += weight[P_CFL] * e_cfl * e_cfl;
+        double c_cfl = 2 * weight[P_CFL] * e_cfl / target[P_CFL] / area;
+
+        for(int i = 0; i < n; i++) {
+            gd[i] += c_md + c_sd * (d[i] - md) +
+                     (c_mh + c_sh * (h[i] - mh)) * dh[i] + c_cfl * df[i];
+        }
+
+        // Canopy cover
+        if(weight[P_COVER] > 0) {
+            vector<double> cgx(n), cgy(n), cgr(n);
+            double cover = softCover(x, y, cgx.data(), cgy.data(), cgr.data()) - cover_offset;
+            double denom = max(target[P_COVER], 0.1);
+            double e = (cover - target[P_COVER]) / denom;
+            E += weight[P_COVER] * e * e;
+            double c = 2 * weight[P_COVER] * e / denom;
+            for(int i = 0; i < n; i++) {
+                gx[i] += c * cgx[i];
+                gy[i] += c * cgy[i];
+                gd[i] += c * cgr[i] * dr[i];
+            }
+        }
+
+        // Clark-Evans R
+        if(weight[P_CE] > 0 && n > 1) {
+            vector<double> cgx(n, 0.0), cgy(n, 0.0);
+            double ce = softCE(x, y, cgx.data(), cgy.data()) - ce_offset;
+            double e = (ce - target[P_CE]) / target[P_CE];
+            E += weight[P_CE] * e * e;
+            double c = 2 * weight[P_CE] * e / target[P_CE];
+            for(int i = 0; i < n; i++) {
+                gx[i] += c * cgx[i];
+                gy[i] += c * cgy[i];
+            }
+        }
+        return E;
+    }
+
+    // Keep coordinates inside the plot and DBH above the minimum
+    void project(double* v) const {
+        double hi = plot_size * (1.0 - 1e-12);
+        for(int i = 0; i < 2 * n; i++) v[i] = min(max(v[i], 0.0), hi);
+        for(int i = 2 * n; i < 3 * n; i++) v[i] = max(v[i], dbh_min);
+    }
+
+    // Infinity norm of the projected gradient (zero where a bound blocks descent)
+    double projectedGradientNorm(const double* v, const double* g) const {
+        double hi = plot_size * (1.0 - 1e-12);
+        double norm = 0.0;
+        for(int i = 0; i < 3 * n; i++) {
+            double lo_b = i < 2 * n ? 0.0 : dbh_min;
+            bool at_lo = v[i] <= lo_b && g[i] > 0;
+            bool at_hi = i < 2 * n && v[i] >= hi && g[i] < 0;
+            if(!at_lo && !at_hi) norm = max(norm, fabs(g[i]));
+        }
+        return norm;
+    }
+};
+
+// Projected L-BFGS with Armijo backtracking; returns iterations used
+static int lbfgsMinimize(PolishProblem& prob, vector<double>& v, int max_iter,
+                         int memory, double tol, double& f, int& n_eval) {
+    size_t dim = v.size();
+    vector<double> g(dim), v_new(dim), g_new(dim), p(dim), alpha(memory);
+    vector<vector<double> > S, Y;
+    vector<double> rho;
+
+    prob.project(v.data());
+    f = prob.evaluate(v.data(), g.data());
+    n_eval++;
+
+    int it = 0;
+    for(; it < max_iter; it++) {
+        if(prob.projectedGradientNorm(v.data(), g.data()) < tol) break;
+
+        // Two-loop recursion: p = -H g
+        for(size_t i = 0; i < dim; i++) p[i] = -g[i];
+        int m = (int)S.size();
+        for(int k = m - 1; k >= 0; k--) {
+            double a = 0;
+            for(size_t i = 0; i < dim; i++) a += S[k][i] * p[i];
+            a *= rho[k];
+            alpha[k] = a;
+            for(size_t i = 0; i < dim; i++) p[i] -= a * Y[k][i];
+        }
+        if(m > 0) {
+            double sy = 0, yy = 0;
+            for(size_t i = 0; i < dim; i++) { sy += S[m - 1][i] * Y[m - 1][i]; yy += Y[m - 1][i] * Y[m - 1][i]; }
+            double gamma = sy / yy;
+            for(size_t i = 0; i < dim; i++) p[i] *= gamma;
+        }
+        for(int k = 0; k < m; k++) {
+            double b = 0;
+            for(size_t i = 0; i < dim; i++) b += Y[k][i] * p[i];
+            b *= rho[k];
+            for(size_t i = 0; i < dim; i++) p[i] += S[k][i] * (alpha[k] - b);
+        }
+
+        double gp = 0;
+        for(size_t i = 0; i < dim; i++) gp += g[i] * p[i];
+        if(gp >= 0) {
+            // Not a descent direction: fall back to steepest descent
+            S.clear(); Y.clear(); rho.clear();
+            for(size_t i = 0; i < dim; i++) p[i] = -g[i];
+        }
+
+        // First step without curvature information: move at most ~0.5 m / cm
+        double step = 1.0;
+        if(S.empty()) {
+            double pmax = 0;
+            for(size_t i = 0; i < dim; i++) pmax = max(pmax, fabs(p[i]));
+            if(pmax > 0) step = min(1.0, 0.5 / pmax);
+        }
+
+        bool found = false;
+        double f_new = f;
+        for(int ls = 0; ls < 30; ls++) {
+            for(size_t i = 0; i < dim; i++) v_new[i] = v[i] + step * p[i];
+            prob.project(v_new.data());
+            double decrease = 0;
+            for(size_t i = 0; i < dim; i++) decrease += g[i] * (v_new[i] - v[i]);
+            f_new = prob.evaluate(v_new.data(), g_new.data());
+            n_eval++;
+            if(f_new <= f + 1e-4 * decrease && decrease < 0) { found = true; break; }
+            step *= 0.5;
+        }
+        if(!found) {
+            if(S.empty()) break;
+            S.clear(); Y.clear(); rho.clear();
+            continue;
+        }
+
+        vector<double> s(dim), y(dim);
+        double sy = 0;
+        for(size_t i = 0; i < dim; i++) {
+            s[i] = v_new[i] - v[i];
+            y[i] = g_new[i] - g[i];
+            sy += s[i] * y[i];
+        }
+        if(sy > 1e-12) {
+            if((int)S.size() == memory) {
+                S.erase(S.begin()); Y.erase(Y.begin()); rho.erase(rho.begin());
+            }
+            S.push_back(s); Y.push_back(y); rho.push_back(1.0 / sy);
+        }
+
+        double f_old = f;
+        v.swap(v_new);
+        g.swap(g_new);
+        f = f_new;
+        if(f_old - f <= tol * max(1.0, fabs(f_old))) { it++; break; }
+
+        if((it & 15) == 0) checkUserInterrupt();
+    }
+    return it;
+}
+
+// [[Rcpp::plugins(openmp)]]
+// [[Rcpp::export]]
+List polishStandCpp(NumericVector x, NumericVector y, NumericVector dbh,
+                    IntegerVector species, NumericVector dbh_grid,
+                    NumericMatrix height_tab, NumericMatrix radius_tab,
+                    NumericMatrix fuel_tab, NumericVector target,
+                    NumericVector weight, double plot_size,
+                    double grid_res = 0.5, double edge_width = 0.125,
+                    double nn_temperature = 0.1, int k_nn = 6,
+                    double dbh_min = 5.0, int max_iter = 200, int n_rounds = 3,
+                    int memory = 7, double tol = 1e-8, int n_threads = 0) {
+    int n = x.size();
+    if(y.size() != n || dbh.size() != n || species.size() != n) {
+        stop("x, y, dbh and species must have the same length");
+    }
+    if(target.size() != P_N || weight.size() != P_N) {
+        stop("target and weight must have length %d", (int)P_N);
+    }
+    if(dbh_grid.size() < 2) stop("dbh_grid needs at least two points");
+
+    #ifdef _OPENMP
+    if(n_threads > 0) {
+        omp_set_num_threads(n_threads);
+    }
+    #endif
+
+    vector<int> sp(n);
+    for(int i = 0; i < n; i++) sp[i] = species[i] - 1;
+
+    PolishProblem prob;
+    prob.n = n;
+    prob.n_species = height_tab.ncol();
+    prob.n_grid = dbh_grid.size();
+    prob.k_nn = max(1, k_nn);
+    prob.n_cells = (int)ceil(plot_size / grid_res);
+    prob.species = sp.data();
+    prob.grid_min = dbh_grid[0];
+    prob.grid_step = dbh_grid[1] - dbh_grid[0];
+    prob.h_tab = height_tab.begin();
+    prob.r_tab = radius_tab.begin();
+    prob.f_tab = fuel_tab.begin();
+    prob.plot_size = plot_size;
+    prob.grid_res = grid_res;
+    prob.tau = edge_width;
+    prob.temp = nn_temperature;
+    prob.dbh_min = dbh_min;
+    for(int k = 0; k < P_N; k++) {
+        prob.target[k] = target[k];
+        prob.weight[k] = R_finite(weight[k]) ? weight[k] : 0.0;
+    }
+
+    vector<double> v(3 * n);
+    for(int i = 0; i < n; i++) {
+        v[i] = x[i];
+        v[n + i] = y[i];
+        v[2 * n + i] = dbh[i];
+    }
+
+    double f = 0.0;
+    int iterations = 0, n_eval = 0;
+    int per_round = max(1, max_iter / max(1, n_rounds));
+    vector<double> scratch(3 * n);
+    for(int round = 0; round < n_rounds && iterations < max_iter; round++) {
+        // Recalibrate: surrogate metrics minus exact metrics at the current point
+        double ce_exact, cover_exact;
+        prob.exactMetrics(v.data(), ce_exact, cover_exact);
+        prob.ce_offset = 0.0;
+        prob.cover_offset = 0.0;
+        vector<double> gx(n, 0.0), gy(n, 0.0), gr(n);
+        prob.allometry(v.data() + 2 * n);
+        if(n > 1) prob.ce_offset = prob.softCE(v.data(), v.data() + n, gx.data(), gy.data()) - ce_exact;
+        prob.cover_offset = prob.softCover(v.data(), v.data() + n, gx.data(), gy.data(), gr.data()) -
+                            cover_exact;
+
+        int it = lbfgsMinimize(prob, v, min(per_round, max_iter - iterations), memory, tol,
+                               f, n_eval);
+        iterations += it;
+        if(it == 0) break;
+    }
+
+    double ce_exact, cover_exact;
+    prob.exactMetrics(v.data(), ce_exact, cover_exact);
+
+    NumericVector ox(n), oy(n), od(n);
+    for(int i = 0; i < n; i++) {
+        ox[i] = v[i];
+        oy[i] = v[n + i];
+        od[i] = v[2 * n + i];
+    }
+    return List::create(
+        Named("x") = ox,
+        Named("y") = oy,
+        Named("DBH") = od,
+        Named("surrogate_energy") = f,
+        Named("clark_evans_r") = ce_exact,
+        Named("canopy_cover") = cover_exact,
+        Named("iterations") = iterations,
+        Named("evaluations") = n_eval
+    );
+}
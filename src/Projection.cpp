@@ -0,0 +1,443 @@
+#include <Rcpp.h>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <stdint.h>
+#include "SpatialIndex.h"
+#include "CanopyCover.h"
+#include "Allometry.h"
+#include "StandRNG.h"
+#include "RunControl.h"
+#include "MemoryProfile.h"
+#include "StandStore.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace Rcpp;
+using namespace std;
+
+// ==============================================================================
+// MULTI-YEAR GROWTH AND MORTALITY PROJECTION
+// ==============================================================================
+// Advances an ensemble of stands year by year:
+//   1. competition: Hegyi index CI_i = sum_j (D_j / D_i) / dist_ij over live
+//      neighbours within the competition radius (toroidal; neighbour lists
+//      are built once from a cell grid since trees do not move, and hold
+//      every tree within the radius)
+//   2. growth: dD = a * D^b * exp(-c * D) * exp(-competition * CI)
+//   3. mortality: p = min(1, base + size_effect * exp(-dbh_coef * D)) *
+//      (1 + competition * CI), capped at 1 again, from the pre-growth state
+//   4. allometry re-derived with the fused kernel (or compiled equations);
+//      cover (crown-count raster or per-row chord intervals), CFL and CBD
+//      sums are updated only for the changed trees
+// Stands are independent and run in parallel. Each stand draws from its own
+// generator seeded from R, so results do not depend on the thread count.
+// Projected trees are written straight into a native stand store
+// (StandStore.h) that R views without copying.
+//
+// With profile = TRUE the result includes a MemoryProfile (MemoryProfile.h):
+// time, heap allocations and peak bytes of the setup, projection (all
+// threads, so the peak covers the stands in flight together) and output
+// phases; the time and calls of the per-stand kernels, summed over stands
+// (StandProfile; the threads share the allocation counters, so these carry
+// no allocation counts); and the footprint of the tree and summary arrays
+// and of the largest neighbour lists, competition arrays and cover structure
+// of a stand.
+
+// Summary columns recorded per stand and year
+enum { PS_N = 0, PS_MEAN_DBH, PS_MEAN_HEIGHT, PS_BASAL_AREA, PS_COVER, PS_CBD,
+       PS_CFL, PS_COLS };
+
+enum { COVER_RASTER = 0, COVER_INTERVALS = 1 };
+
+struct ProjectionSettings {
+    int years, record_every, n_species, cbh_method, foliage_method, cover_method;
+    double grid_res, comp_radius;
+    const AllometryCoefs* allometry;     // per species
+    const AllometryProgram* program;     // compiled equations, or NULL
+    const double* growth;                // n_species x 4: a, b, c, competition
+    const double* mortality;             // n_species x 4: base, size_effect, dbh_coef, competition
+};
+
+// Kernels of projectStand timed for the profile
+enum { PK_NEIGHBOURS = 0, PK_INITIAL, PK_GROWTH, PK_MORTALITY, PK_COUNT };
+static const char* const PK_NAMES[PK_COUNT] = {"neighbours", "initial", "growth", "mortality"};
+
+// Kernel times and structure bytes of one stand; written by the thread
+// projecting it
+struct StandProfile {
+    typedef std::chrono::steady_clock Clock;
+    double seconds[PK_COUNT];
+    long calls[PK_COUNT];
+    double neighbours, competition, cover;
+    Clock::time_point t0;
+
+    StandProfile() : neighbours(0), competition(0), cover(0) {
+        for(int k = 0; k < PK_COUNT; k++) {
+            seconds[k] = 0;
+            calls[k] = 0;
+        }
+    }
+    void start() { t0 = Clock::now(); }
+    void stop(int k) {
+        seconds[k] += std::chrono::duration<double>(Clock::now() - t0).count();
+        calls[k]++;
+    }
+};
+
+// Attributes of a tree from the compiled equations if given, else the fused
+// kernel
+static inline TreeSize treeSize(const ProjectionSettings& st, int sp, double dbh) {
+    if(st.program != NULL) return st.program->eval(sp, dbh);
+    return evalAllometry(st.allometry[sp], st.cbh_method, st.foliage_method, dbh);
+}
+
+// Interrupt check between years: thread 0 polls R, the other threads only
+// read the flag it sets
+static inline bool yearStopped(RunControl& run) {
+#ifdef _OPENMP
+    if(omp_get_thread_num() != 0) return run.stopped();
+#endif
+    return run.poll();
+}
+
+// Project one stand in place. dbh/height/... are the stand's slices of the
+// flat output vectors; summary has n_records rows of PS_COLS values. Cover is
+// CoverRaster or IntervalCover (same interface). pf, if not NULL, receives
+// the kernel times and structure bytes. Returns false if the run was
+// interrupted before the last year.
+template <class Cover>
+static bool projectStand(const ProjectionSettings& st, int n, double plot_size,
+                         const double* x, const double* y, const int* species,
+                         double* dbh, double* height, double* radius,
+                         double* crown_base, double* fuel, int* death_year,
+                         double* summary, uint64_t seed, RunControl& run,
+                         StandProfile* pf) {
+    double area = plot_size * plot_size;
+    StandRNG rng(seed);
+
+    // Neighbour lists (CSR) within the competition radius
+    if(pf) pf->start();
+    vector<int> nb_start(n + 1, 0), nb_idx;
+    vector<double> nb_dist;
+    if(n > 1 && st.comp_radius > 0) {
+        TorusGrid grid(plot_size, plot_size, st.comp_radius, n);
+        for(int i = 0; i < n; i++) grid.insert(i, x[i], y[i]);
+        vector<int> stamp(n, -1), found;
+        for(int i = 0; i < n; i++) {
+            found.clear();
+            grid.collect(x[i], y[i], st.comp_radius, stamp, i, found);
+            for(size_t m = 0; m < found.size(); m++) {
+                int j = found[m];
+                if(j == i) continue;
+                double d = grid.dist(j, x[i], y[i]);
+                if(d > st.comp_radius) continue;
+                nb_idx.push_back(j);
+                nb_dist.push_back(max(d, 0.1));
+            }
+            nb_start[i + 1] = (int)nb_idx.size();
+        }
+    }
+    if(pf) {
+        pf->stop(PK_NEIGHBOURS);
+        pf->neighbours = vectorBytes(nb_start) + vectorBytes(nb_idx) + vectorBytes(nb_dist);
+    }
+
+    // Initial attributes, raster and running sums
+    if(pf) pf->start();
+    Cover raster(plot_size, st.grid_res);
+    vector<char> alive(n, 1);
+    double sum_fuel = 0, sum_volume = 0, sum_dbh = 0, sum_height = 0, sum_ba = 0;
+    int n_live = n;
+    for(int i = 0; i < n; i++) {
+        TreeSize t = treeSize(st, species[i], dbh[i]);
+        height[i] = t.height;
+        radius[i] = t.crown_radius;
+        crown_base[i] = t.crown_base;
+        fuel[i] = t.fuel_mass;
+        death_year[i] = NA_INTEGER;
+        raster.add(x[i], y[i], radius[i]);
+        sum_fuel += fuel[i];
+        sum_volume += M_PI * radius[i] * radius[i] * (height[i] - crown_base[i]);
+        sum_dbh += dbh[i];
+        sum_height += height[i];
+        sum_ba += M_PI * (dbh[i] / 200.0) * (dbh[i] / 200.0);
+    }
+    if(pf) {
+        pf->stop(PK_INITIAL);
+        pf->cover = (double)raster.bytes();
+    }
+
+    double* out = summary;
+    int n_sp = st.n_species;
+    vector<double> ci(n), new_dbh(n);
+    if(pf) pf->competition = vectorBytes(alive) + vectorBytes(ci) + vectorBytes(new_dbh);
+
+    for(int year = 0; year <= st.years; year++) {
+        if(year > 0) {
+            if(yearStopped(run)) return false;
+
+            // Competition and growth from last year's sizes (synchronous update)
+            if(pf) pf->start();
+            for(int i = 0; i < n; i++) {
+                if(!alive[i]) continue;
+                double c = 0.0;
+                for(int m = nb_start[i]; m < nb_start[i + 1]; m++) {
+                    int j = nb_idx[m];
+                    if(alive[j]) c += (dbh[j] / dbh[i]) / nb_dist[m];
+                }
+                ci[i] = c;
+                int sp = species[i];
+                const double* g = st.growth;
+                double inc = g[sp] * pow(dbh[i], g[n_sp + sp]) * exp(-g[2 * n_sp + sp] * dbh[i]) *
+                             exp(-g[3 * n_sp + sp] * c);
+                new_dbh[i] = dbh[i] + max(inc, 0.0);
+            }
+            if(pf) {
+                pf->stop(PK_GROWTH);
+                pf->start();
+            }
+
+            for(int i = 0; i < n; i++) {
+                if(!alive[i]) continue;
+                int sp = species[i];
+                const double* mp = st.mortality;
+                double p = mp[sp] + mp[n_sp + sp] * exp(-mp[2 * n_sp + sp] * dbh[i]);
+                p = min(1.0, min(1.0, max(0.0, p)) * (1.0 + mp[3 * n_sp + sp] * ci[i]));
+
+                double old_volume = M_PI * radius[i] * radius[i] * (height[i] - crown_base[i]);
+                double old_ba = M_PI * (dbh[i] / 200.0) * (dbh[i] / 200.0);
+                sum_fuel -= fuel[i];
+                sum_volume -= old_volume;
+                sum_dbh -= dbh[i];
+                sum_height -= height[i];
+                sum_ba -= old_ba;
+
+                if(rng.uniform() < p) {
+                    alive[i] = 0;
+                    death_year[i] = year;
+                    n_live--;
+                    raster.remove(x[i], y[i], radius[i]);
+                    continue;
+                }
+
+                dbh[i] = new_dbh[i];
+                TreeSize t = treeSize(st, sp, dbh[i]);
+                raster.resize(x[i], y[i], radius[i], t.crown_radius);
+                height[i] = t.height;
+                radius[i] = t.crown_radius;
+                crown_base[i] = t.crown_base;
+                fuel[i] = t.fuel_mass;
+                sum_fuel += fuel[i];
+                sum_volume += M_PI * radius[i] * radius[i] * (height[i] - crown_base[i]);
+                sum_dbh += dbh[i];
+                sum_height += height[i];
+                sum_ba += M_PI * (dbh[i] / 200.0) * (dbh[i] / 200.0);
+            }
+            if(pf) {
+                pf->stop(PK_MORTALITY);
+                pf->cover = max(pf->cover, (double)raster.bytes());
+            }
+        }
+
+        if(year % st.record_every == 0 || year == st.years) {
+            out[PS_N] = n_live;
+            out[PS_MEAN_DBH] = n_live > 0 ? sum_dbh / n_live : NA_REAL;
+            out[PS_MEAN_HEIGHT] = n_live > 0 ? sum_height / n_live : NA_REAL;
+            out[PS_BASAL_AREA] = sum_ba / (area / 10000.0);
+            out[PS_COVER] = raster.fraction();
+            out[PS_CBD] = sum_volume > 0 ? sum_fuel / sum_volume : 0.0;
+            out[PS_CFL] = sum_fuel / area;
+            out += PS_COLS;
+        }
+    }
+    return true;
+}
+
+// [[Rcpp::plugins(openmp)]]
+// [[Rcpp::export]]
+List projectStandsCpp(IntegerVector start, IntegerVector n, NumericVector plot_size,
+                      NumericVector x, NumericVector y, NumericVector dbh,
+                      IntegerVector species, NumericMatrix allometry,
+                      int cbh_method, int foliage_method, List program,
+                      NumericMatrix growth,
+                      NumericMatrix mortality, IntegerVector seeds, int years,
+                      int record_every = 1, double comp_radius = 6.0,
+                      double grid_res = 0.5, int cover_method = 0,
+                      int n_threads = 0, double progress = 0.0, bool profile = false) {
+    MemoryProfile prof(profile);
+    prof.phase("setup");
+    int n_stands = start.size();
+    int n_species = allometry.nrow();
+    if(allometry.ncol() != ALLOMETRY_N_COEFS) {
+        stop("allometry must have %d columns", ALLOMETRY_N_COEFS);
+    }
+    if(growth.nrow() != n_species || growth.ncol() != 4 ||
+       mortality.nrow() != n_species || mortality.ncol() != 4) {
+        stop("growth and mortality must have one row per species and 4 columns");
+    }
+    if(years < 0 || record_every < 1) stop("years must be >= 0 and record_every >= 1");
+
+    vector<AllometryCoefs> coefs(n_species);
+    for(int s = 0; s < n_species; s++) coefs[s].load(allometry.begin(), n_species, s);
+
+    // Compiled equations (list(op, arg, entry) with one entry row per species)
+    // replace the fused kernel when given
+    bool use_program = program.size() > 0;
+    IntegerVector op = use_program ? as<IntegerVector>(program["op"]) : IntegerVector(0);
+    NumericVector arg = use_program ? as<NumericVector>(program["arg"]) : NumericVector(0);
+    IntegerMatrix entry = use_program ? as<IntegerMatrix>(program["entry"]) : IntegerMatrix(0, ALLOMETRY_N_ATTRS);
+    if(use_program && (op.size() != arg.size() || entry.nrow() != n_species ||
+                       entry.ncol() != ALLOMETRY_N_ATTRS)) {
+        stop("program must have one entry row per species");
+    }
+    AllometryProgram prog(op.begin(), arg.begin(), op.size(), entry.begin(),
+                          use_program ? n_species : 0);
+    if(!prog.valid()) stop("invalid allometry program");
+
+    ProjectionSettings st;
+    st.years = years;
+    st.record_every = record_every;
+    st.n_species = n_species;
+    st.cbh_method = cbh_method;
+    st.foliage_method = foliage_method;
+    st.grid_res = grid_res;
+    st.cover_method = cover_method;
+    st.comp_radius = comp_radius;
+    st.allometry = coefs.data();
+    st.program = use_program ? &prog : NULL;
+    st.growth = growth.begin();
+    st.mortality = mortality.begin();
+
+    int n_records = 0;
+    for(int year = 0; year <= years; year++) {
+        if(year % record_every == 0 || year == years) n_records++;
+    }
+
+    int n_trees = x.size();
+    vector<int> sp(n_trees);
+    for(int i = 0; i < n_trees; i++) sp[i] = species[i] - 1;
+
+    // Projected trees, filled in place by the stands
+    RObject trees = wrapStandStore(new StandStore());
+    StandStore* store = (StandStore*)R_ExternalPtrAddr(trees);
+    const char* columns[] = {"DBH", "Height", "CrownRadius", "CrownBaseHeight",
+                             "CanopyFuelMass"};
+    for(int c = 0; c < 5; c++) store->add(columns[c], StandColumn::REAL, n_trees);
+    store->add("DeathYear", StandColumn::INTEGER, n_trees);
+    vector<double> summary((size_t)n_stands * n_records * PS_COLS);
+
+    const int* pstart = start.begin();
+    const int* pn = n.begin();
+    const double* pplot = plot_size.begin();
+    const int* pseed = seeds.begin();
+    const double* px = x.begin();
+    const double* py = y.begin();
+    double* pd = store->real("DBH");
+    double* ph = store->real("Height");
+    double* pr = store->real("CrownRadius");
+    double* pc = store->real("CrownBaseHeight");
+    double* pf = store->real("CanopyFuelMass");
+    int* pdeath = store->integer("DeathYear");
+    std::copy(dbh.begin(), dbh.end(), pd);
+
+    // Stands stop at the next year when an interrupt arrives and stands not
+    // yet started are skipped; the R side keeps only the completed ones.
+    // Thread 0 polls between the years of its stands (yearStopped).
+    RunControl run("projection", n_stands, progress, 1);
+    vector<int> completed(n_stands, 0);
+    vector<StandProfile> stand_prof(prof.enabled() ? n_stands : 0);
+    int k_stand[PK_COUNT];
+    for(int k = 0; k < PK_COUNT; k++) k_stand[k] = prof.kernel(PK_NAMES[k]);
+    prof.phase("project");
+
+    #ifdef _OPENMP
+    if(n_threads > 0) {
+        omp_set_num_threads(n_threads);
+    }
+    #pragma omp parallel for schedule(dynamic, 1)
+    #endif
+    for(int s = 0; s < n_stands; s++) {
+        if(run.stopped()) continue;
+        int s0 = pstart[s];
+        double* out = summary.data() + (size_t)s * n_records * PS_COLS;
+        uint64_t seed = (uint64_t)(unsigned int)pseed[s];
+        StandProfile* pfs = prof.enabled() ? &stand_prof[s] : NULL;
+        bool done;
+        if(st.cover_method == COVER_INTERVALS) {
+            done = projectStand<IntervalCover>(st, pn[s], pplot[s], px + s0, py + s0,
+                                               sp.data() + s0, pd + s0, ph + s0, pr + s0,
+                                               pc + s0, pf + s0, pdeath + s0, out, seed, run,
+                                               pfs);
+        } else {
+            done = projectStand<CoverRaster>(st, pn[s], pplot[s], px + s0, py + s0,
+                                             sp.data() + s0, pd + s0, ph + s0, pr + s0,
+                                             pc + s0, pf + s0, pdeath + s0, out, seed, run,
+                                             pfs);
+        }
+        if(!done) continue;
+        completed[s] = 1;
+        run.done++;
+    }
+    run.finish();
+    prof.phase("output");
+
+    // Long-format summary: one row per stand and recorded year
+    int n_rows = n_stands * n_records;
+    IntegerVector out_stand(n_rows), out_year(n_rows);
+    NumericVector out_n(n_rows), out_mean_dbh(n_rows), out_mean_h(n_rows), out_ba(n_rows),
+                  out_cover(n_rows), out_cbd(n_rows), out_cfl(n_rows);
+    for(int s = 0; s < n_stands; s++) {
+        int rec = 0;
+        for(int year = 0; year <= years; year++) {
+            if(!(year % record_every == 0 || year == years)) continue;
+            int row = s * n_records + rec;
+            const double* v = &summary[(size_t)row * PS_COLS];
+            out_stand[row] = s + 1;
+            out_year[row] = year;
+            out_n[row] = v[PS_N];
+            out_mean_dbh[row] = v[PS_MEAN_DBH];
+            out_mean_h[row] = v[PS_MEAN_HEIGHT];
+            out_ba[row] = v[PS_BASAL_AREA];
+            out_cover[row] = v[PS_COVER];
+            out_cbd[row] = v[PS_CBD];
+            out_cfl[row] = v[PS_CFL];
+            rec++;
+        }
+    }
+
+    prof.footprint("trees", (double)(x.size() + y.size() + dbh.size()) * sizeof(double) +
+                            (double)species.size() * sizeof(int) + vectorBytes(sp) +
+                            store->bytes());
+    prof.footprint("summary", vectorBytes(summary));
+    for(size_t s = 0; s < stand_prof.size(); s++) {
+        prof.footprint("neighbours", stand_prof[s].neighbours);
+        prof.footprint("competition", stand_prof[s].competition);
+        prof.footprint("cover", stand_prof[s].cover);
+    }
+    for(int k = 0; k < PK_COUNT; k++) {
+        long calls = 0;
+        double seconds = 0.0;
+        for(size_t s = 0; s < stand_prof.size(); s++) {
+            calls += stand_prof[s].calls[k];
+            seconds += stand_prof[s].seconds[k];
+        }
+        prof.timed(k_stand[k], calls, seconds);
+    }
+
+    return List::create(
+        Named("summary") = List::create(
+            Named("stand") = out_stand, Named("year") = out_year,
+            Named("n_trees") = out_n, Named("mean_dbh") = out_mean_dbh,
+            Named("mean_height") = out_mean_h, Named("basal_area") = out_ba,
+            Named("canopy_cover") = out_cover, Named("cbd") = out_cbd,
+            Named("cfl") = out_cfl),
+        Named("trees") = trees,
+        Named("completed") = LogicalVector(completed.begin(), completed.end()),
+        Named("interrupted") = run.stopped(),
+        Named("profile") = prof.result()
+    );
+}
@@ -10,6 +10,231 @@ Rcpp::Rostream<true>&  Rcpp::Rcout = Rcpp::Rcpp_cout_get();
 Rcpp::Rostream<false>& Rcpp::Rcerr = Rcpp::Rcpp_cerr_get();
 #endif
 
+// calcAllometryProgramCpp
+List calcAllometryProgramCpp(NumericVector dbh, IntegerVector species, IntegerVector op, NumericVector arg, IntegerMatrix entry, int n_threads);
+RcppExport SEXP _EmpiricalPatternR_calcAllometryProgramCpp(SEXP dbhSEXP, SEXP speciesSEXP, SEXP opSEXP, SEXP argSEXP, SEXP entrySEXP, SEXP n_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type dbh(dbhSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type species(speciesSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type op(opSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type arg(argSEXP);
+    Rcpp::traits::input_parameter< IntegerMatrix >::type entry(entrySEXP);
+    Rcpp::traits::input_parameter< int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(calcAllometryProgramCpp(dbh, species, op, arg, entry, n_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// approxCanopyCoverCpp
+List approxCanopyCoverCpp(NumericVector x, NumericVector y, NumericVector crown_radius, double plot_size, double tolerance, int n_rep, int n_start, double max_points, int seed);
+RcppExport SEXP _EmpiricalPatternR_approxCanopyCoverCpp(SEXP xSEXP, SEXP ySEXP, SEXP crown_radiusSEXP, SEXP plot_sizeSEXP, SEXP toleranceSEXP, SEXP n_repSEXP, SEXP n_startSEXP, SEXP max_pointsSEXP, SEXP seedSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type crown_radius(crown_radiusSEXP);
+    Rcpp::traits::input_parameter< double >::type plot_size(plot_sizeSEXP);
+    Rcpp::traits::input_parameter< double >::type tolerance(toleranceSEXP);
+    Rcpp::traits::input_parameter< int >::type n_rep(n_repSEXP);
+    Rcpp::traits::input_parameter< int >::type n_start(n_startSEXP);
+    Rcpp::traits::input_parameter< double >::type max_points(max_pointsSEXP);
+    Rcpp::traits::input_parameter< int >::type seed(seedSEXP);
+    rcpp_result_gen = Rcpp::wrap(approxCanopyCoverCpp(x, y, crown_radius, plot_size, tolerance, n_rep, n_start, max_points, seed));
+    return rcpp_result_gen;
+END_RCPP
+}
+// approxClarkEvansCpp
+List approxClarkEvansCpp(NumericVector x, NumericVector y, double plot_size, double tolerance, int n_start, int max_sample, int seed);
+RcppExport SEXP _EmpiricalPatternR_approxClarkEvansCpp(SEXP xSEXP, SEXP ySEXP, SEXP plot_sizeSEXP, SEXP toleranceSEXP, SEXP n_startSEXP, SEXP max_sampleSEXP, SEXP seedSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< double >::type plot_size(plot_sizeSEXP);
+    Rcpp::traits::input_parameter< double >::type tolerance(toleranceSEXP);
+    Rcpp::traits::input_parameter< int >::type n_start(n_startSEXP);
+    Rcpp::traits::input_parameter< int >::type max_sample(max_sampleSEXP);
+    Rcpp::traits::input_parameter< int >::type seed(seedSEXP);
+    rcpp_result_gen = Rcpp::wrap(approxClarkEvansCpp(x, y, plot_size, tolerance, n_start, max_sample, seed));
+    return rcpp_result_gen;
+END_RCPP
+}
+// calcCanopyHeightCpp
+List calcCanopyHeightCpp(NumericVector x, NumericVector y, NumericVector crown_radius, NumericVector height, NumericVector crown_base, double plot_size, double grid_res, int profile, int top_k, IntegerVector drop, NumericVector probs, double min_height, double height_res);
+RcppExport SEXP _EmpiricalPatternR_calcCanopyHeightCpp(SEXP xSEXP, SEXP ySEXP, SEXP crown_radiusSEXP, SEXP heightSEXP, SEXP crown_baseSEXP, SEXP plot_sizeSEXP, SEXP grid_resSEXP, SEXP profileSEXP, SEXP top_kSEXP, SEXP dropSEXP, SEXP probsSEXP, SEXP min_heightSEXP, SEXP height_resSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type crown_radius(crown_radiusSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type height(heightSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type crown_base(crown_baseSEXP);
+    Rcpp::traits::input_parameter< double >::type plot_size(plot_sizeSEXP);
+    Rcpp::traits::input_parameter< double >::type grid_res(grid_resSEXP);
+    Rcpp::traits::input_parameter< int >::type profile(profileSEXP);
+    Rcpp::traits::input_parameter< int >::type top_k(top_kSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type drop(dropSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type probs(probsSEXP);
+    Rcpp::traits::input_parameter< double >::type min_height(min_heightSEXP);
+    Rcpp::traits::input_parameter< double >::type height_res(height_resSEXP);
+    rcpp_result_gen = Rcpp::wrap(calcCanopyHeightCpp(x, y, crown_radius, height, crown_base, plot_size, grid_res, profile, top_k, drop, probs, min_height, height_res));
+    return rcpp_result_gen;
+END_RCPP
+}
+// crownFireIndicesCpp
+List crownFireIndicesCpp(NumericVector cbh, NumericVector cbd, NumericVector fuel, NumericVector fuel10, NumericVector wind, NumericVector fmc, NumericVector m1, NumericVector m10, NumericVector m100, NumericVector m_live, NumericVector waf, NumericVector slope, int n_threads);
+RcppExport SEXP _EmpiricalPatternR_crownFireIndicesCpp(SEXP cbhSEXP, SEXP cbdSEXP, SEXP fuelSEXP, SEXP fuel10SEXP, SEXP windSEXP, SEXP fmcSEXP, SEXP m1SEXP, SEXP m10SEXP, SEXP m100SEXP, SEXP m_liveSEXP, SEXP wafSEXP, SEXP slopeSEXP, SEXP n_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type cbh(cbhSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type cbd(cbdSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type fuel(fuelSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type fuel10(fuel10SEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type wind(windSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type fmc(fmcSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type m1(m1SEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type m10(m10SEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type m100(m100SEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type m_live(m_liveSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type waf(wafSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type slope(slopeSEXP);
+    Rcpp::traits::input_parameter< int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(crownFireIndicesCpp(cbh, cbd, fuel, fuel10, wind, fmc, m1, m10, m100, m_live, waf, slope, n_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// energyTermBuiltin
+SEXP energyTermBuiltin(std::string name, NumericVector params, IntegerVector group);
+RcppExport SEXP _EmpiricalPatternR_energyTermBuiltin(SEXP nameSEXP, SEXP paramsSEXP, SEXP groupSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type name(nameSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type params(paramsSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type group(groupSEXP);
+    rcpp_result_gen = Rcpp::wrap(energyTermBuiltin(name, params, group));
+    return rcpp_result_gen;
+END_RCPP
+}
+// repairSeamsCpp
+List repairSeamsCpp(NumericVector x, NumericVector y, IntegerVector tile, int nx, int ny, double tile_size, double seam_width, double max_shift, int iterations, double initial_temp, double final_temp, int seed, double progress);
+RcppExport SEXP _EmpiricalPatternR_repairSeamsCpp(SEXP xSEXP, SEXP ySEXP, SEXP tileSEXP, SEXP nxSEXP, SEXP nySEXP, SEXP tile_sizeSEXP, SEXP seam_widthSEXP, SEXP max_shiftSEXP, SEXP iterationsSEXP, SEXP initial_tempSEXP, SEXP final_tempSEXP, SEXP seedSEXP, SEXP progressSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type tile(tileSEXP);
+    Rcpp::traits::input_parameter< int >::type nx(nxSEXP);
+    Rcpp::traits::input_parameter< int >::type ny(nySEXP);
+    Rcpp::traits::input_parameter< double >::type tile_size(tile_sizeSEXP);
+    Rcpp::traits::input_parameter< double >::type seam_width(seam_widthSEXP);
+    Rcpp::traits::input_parameter< double >::type max_shift(max_shiftSEXP);
+    Rcpp::traits::input_parameter< int >::type iterations(iterationsSEXP);
+    Rcpp::traits::input_parameter< double >::type initial_temp(initial_tempSEXP);
+    Rcpp::traits::input_parameter< double >::type final_temp(final_tempSEXP);
+    Rcpp::traits::input_parameter< int >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< double >::type progress(progressSEXP);
+    rcpp_result_gen = Rcpp::wrap(repairSeamsCpp(x, y, tile, nx, ny, tile_size, seam_width, max_shift, iterations, initial_temp, final_temp, seed, progress));
+    return rcpp_result_gen;
+END_RCPP
+}
+// calcStandMetricsTasksCpp
+List calcStandMetricsTasksCpp(NumericVector x, NumericVector y, NumericVector crown_radius, NumericVector dbh, NumericVector height, NumericVector crown_area, NumericVector crown_length, NumericVector fuel, IntegerVector species, int n_species, IntegerVector nurse_group, double plot_size, double grid_res, int n_threads);
+RcppExport SEXP _EmpiricalPatternR_calcStandMetricsTasksCpp(SEXP xSEXP, SEXP ySEXP, SEXP crown_radiusSEXP, SEXP dbhSEXP, SEXP heightSEXP, SEXP crown_areaSEXP, SEXP crown_lengthSEXP, SEXP fuelSEXP, SEXP speciesSEXP, SEXP n_speciesSEXP, SEXP nurse_groupSEXP, SEXP plot_sizeSEXP, SEXP grid_resSEXP, SEXP n_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type crown_radius(crown_radiusSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type dbh(dbhSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type height(heightSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type crown_area(crown_areaSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type crown_length(crown_lengthSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type fuel(fuelSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type species(speciesSEXP);
+    Rcpp::traits::input_parameter< int >::type n_species(n_speciesSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type nurse_group(nurse_groupSEXP);
+    Rcpp::traits::input_parameter< double >::type plot_size(plot_sizeSEXP);
+    Rcpp::traits::input_parameter< double >::type grid_res(grid_resSEXP);
+    Rcpp::traits::input_parameter< int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(calcStandMetricsTasksCpp(x, y, crown_radius, dbh, height, crown_area, crown_length, fuel, species, n_species, nurse_group, plot_size, grid_res, n_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// annealStandNativeCpp
+List annealStandNativeCpp(NumericVector x, NumericVector y, IntegerVector species, NumericVector dbh, double plot_size, NumericMatrix allometry, int cbh_method, int foliage_method, List terms, NumericVector move_probs, NumericVector species_probs, double dbh_sd_perturb, int max_iterations, double initial_temp, double cooling_rate, double energy_threshold, int seed, int n_samples, int thin, double sample_temp, Nullable<Function> on_sample, double progress, bool profile);
+RcppExport SEXP _EmpiricalPatternR_annealStandNativeCpp(SEXP xSEXP, SEXP ySEXP, SEXP speciesSEXP, SEXP dbhSEXP, SEXP plot_sizeSEXP, SEXP allometrySEXP, SEXP cbh_methodSEXP, SEXP foliage_methodSEXP, SEXP termsSEXP, SEXP move_probsSEXP, SEXP species_probsSEXP, SEXP dbh_sd_perturbSEXP, SEXP max_iterationsSEXP, SEXP initial_tempSEXP, SEXP cooling_rateSEXP, SEXP energy_thresholdSEXP, SEXP seedSEXP, SEXP n_samplesSEXP, SEXP thinSEXP, SEXP sample_tempSEXP, SEXP on_sampleSEXP, SEXP progressSEXP, SEXP profileSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type species(speciesSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type dbh(dbhSEXP);
+    Rcpp::traits::input_parameter< double >::type plot_size(plot_sizeSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type allometry(allometrySEXP);
+    Rcpp::traits::input_parameter< int >::type cbh_method(cbh_methodSEXP);
+    Rcpp::traits::input_parameter< int >::type foliage_method(foliage_methodSEXP);
+    Rcpp::traits::input_parameter< List >::type terms(termsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type move_probs(move_probsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type species_probs(species_probsSEXP);
+    Rcpp::traits::input_parameter< double >::type dbh_sd_perturb(dbh_sd_perturbSEXP);
+    Rcpp::traits::input_parameter< int >::type max_iterations(max_iterationsSEXP);
+    Rcpp::traits::input_parameter< double >::type initial_temp(initial_tempSEXP);
+    Rcpp::traits::input_parameter< double >::type cooling_rate(cooling_rateSEXP);
+    Rcpp::traits::input_parameter< double >::type energy_threshold(energy_thresholdSEXP);
+    Rcpp::traits::input_parameter< int >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< int >::type n_samples(n_samplesSEXP);
+    Rcpp::traits::input_parameter< int >::type thin(thinSEXP);
+    Rcpp::traits::input_parameter< double >::type sample_temp(sample_tempSEXP);
+    Rcpp::traits::input_parameter< Nullable<Function> >::type on_sample(on_sampleSEXP);
+    Rcpp::traits::input_parameter< double >::type progress(progressSEXP);
+    Rcpp::traits::input_parameter< bool >::type profile(profileSEXP);
+    rcpp_result_gen = Rcpp::wrap(annealStandNativeCpp(x, y, species, dbh, plot_size, allometry, cbh_method, foliage_method, terms, move_probs, species_probs, dbh_sd_perturb, max_iterations, initial_temp, cooling_rate, energy_threshold, seed, n_samples, thin, sample_temp, on_sample, progress, profile));
+    return rcpp_result_gen;
+END_RCPP
+}
+// calcNNStatsCpp
+List calcNNStatsCpp(double xmax, double ymax, NumericVector x, NumericVector y, int k_max, NumericVector r, int n_threads);
+RcppExport SEXP _EmpiricalPatternR_calcNNStatsCpp(SEXP xmaxSEXP, SEXP ymaxSEXP, SEXP xSEXP, SEXP ySEXP, SEXP k_maxSEXP, SEXP rSEXP, SEXP n_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< double >::type xmax(xmaxSEXP);
+    Rcpp::traits::input_parameter< double >::type ymax(ymaxSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< int >::type k_max(k_maxSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type r(rSEXP);
+    Rcpp::traits::input_parameter< int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(calcNNStatsCpp(xmax, ymax, x, y, k_max, r, n_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// calcSpeciesCECpp
+List calcSpeciesCECpp(double xmax, double ymax, NumericVector x, NumericVector y, IntegerVector species, int n_species, int n_threads);
+RcppExport SEXP _EmpiricalPatternR_calcSpeciesCECpp(SEXP xmaxSEXP, SEXP ymaxSEXP, SEXP xSEXP, SEXP ySEXP, SEXP speciesSEXP, SEXP n_speciesSEXP, SEXP n_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< double >::type xmax(xmaxSEXP);
+    Rcpp::traits::input_parameter< double >::type ymax(ymaxSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type species(speciesSEXP);
+    Rcpp::traits::input_parameter< int >::type n_species(n_speciesSEXP);
+    Rcpp::traits::input_parameter< int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(calcSpeciesCECpp(xmax, ymax, x, y, species, n_species, n_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
 // calcCE
 double calcCE(double xmax, double ymax, NumericVector x, NumericVector y);
 RcppExport SEXP _EmpiricalPatternR_calcCE(SEXP xmaxSEXP, SEXP ymaxSEXP, SEXP xSEXP, SEXP ySEXP) {
@@ -90,6 +315,40 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// calcCanopyCoverEllipseCpp
+double calcCanopyCoverEllipseCpp(NumericVector x, NumericVector y, NumericVector semi_a, NumericVector semi_b, NumericVector angle, NumericVector offset_x, NumericVector offset_y, double plot_size, double grid_res);
+RcppExport SEXP _EmpiricalPatternR_calcCanopyCoverEllipseCpp(SEXP xSEXP, SEXP ySEXP, SEXP semi_aSEXP, SEXP semi_bSEXP, SEXP angleSEXP, SEXP offset_xSEXP, SEXP offset_ySEXP, SEXP plot_sizeSEXP, SEXP grid_resSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type semi_a(semi_aSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type semi_b(semi_bSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type angle(angleSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type offset_x(offset_xSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type offset_y(offset_ySEXP);
+    Rcpp::traits::input_parameter< double >::type plot_size(plot_sizeSEXP);
+    Rcpp::traits::input_parameter< double >::type grid_res(grid_resSEXP);
+    rcpp_result_gen = Rcpp::wrap(calcCanopyCoverEllipseCpp(x, y, semi_a, semi_b, angle, offset_x, offset_y, plot_size, grid_res));
+    return rcpp_result_gen;
+END_RCPP
+}
+// calcCanopyCoverIntervalCpp
+double calcCanopyCoverIntervalCpp(NumericVector x, NumericVector y, NumericVector crown_radius, double plot_size, double row_res);
+RcppExport SEXP _EmpiricalPatternR_calcCanopyCoverIntervalCpp(SEXP xSEXP, SEXP ySEXP, SEXP crown_radiusSEXP, SEXP plot_sizeSEXP, SEXP row_resSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type crown_radius(crown_radiusSEXP);
+    Rcpp::traits::input_parameter< double >::type plot_size(plot_sizeSEXP);
+    Rcpp::traits::input_parameter< double >::type row_res(row_resSEXP);
+    rcpp_result_gen = Rcpp::wrap(calcCanopyCoverIntervalCpp(x, y, crown_radius, plot_size, row_res));
+    return rcpp_result_gen;
+END_RCPP
+}
 // calcNearestDistanceCpp
 NumericVector calcNearestDistanceCpp(NumericVector x1, NumericVector y1, NumericVector x2, NumericVector y2);
 RcppExport SEXP _EmpiricalPatternR_calcNearestDistanceCpp(SEXP x1SEXP, SEXP y1SEXP, SEXP x2SEXP, SEXP y2SEXP) {
@@ -157,6 +416,24 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// calcCrownOverlapEllipseCpp
+double calcCrownOverlapEllipseCpp(NumericVector x, NumericVector y, NumericVector semi_a, NumericVector semi_b, NumericVector angle, NumericVector offset_x, NumericVector offset_y, double grid_res);
+RcppExport SEXP _EmpiricalPatternR_calcCrownOverlapEllipseCpp(SEXP xSEXP, SEXP ySEXP, SEXP semi_aSEXP, SEXP semi_bSEXP, SEXP angleSEXP, SEXP offset_xSEXP, SEXP offset_ySEXP, SEXP grid_resSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type semi_a(semi_aSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type semi_b(semi_bSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type angle(angleSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type offset_x(offset_xSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type offset_y(offset_ySEXP);
+    Rcpp::traits::input_parameter< double >::type grid_res(grid_resSEXP);
+    rcpp_result_gen = Rcpp::wrap(calcCrownOverlapEllipseCpp(x, y, semi_a, semi_b, angle, offset_x, offset_y, grid_res));
+    return rcpp_result_gen;
+END_RCPP
+}
 // calcDistributionEnergy
 double calcDistributionEnergy(NumericVector values, NumericVector targets, NumericVector weights);
 RcppExport SEXP _EmpiricalPatternR_calcDistributionEnergy(SEXP valuesSEXP, SEXP targetsSEXP, SEXP weightsSEXP) {
@@ -314,19 +591,283 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// polishStandCpp
+List polishStandCpp(NumericVector x, NumericVector y, NumericVector dbh, IntegerVector species, NumericVector dbh_grid, NumericMatrix height_tab, NumericMatrix radius_tab, NumericMatrix fuel_tab, NumericVector target, NumericVector weight, double plot_size, double grid_res, double edge_width, double nn_temperature, int k_nn, double dbh_min, int max_iter, int n_rounds, int memory, double tol, int n_threads);
+RcppExport SEXP _EmpiricalPatternR_polishStandCpp(SEXP xSEXP, SEXP ySEXP, SEXP dbhSEXP, SEXP speciesSEXP, SEXP dbh_gridSEXP, SEXP height_tabSEXP, SEXP radius_tabSEXP, SEXP fuel_tabSEXP, SEXP targetSEXP, SEXP weightSEXP, SEXP plot_sizeSEXP, SEXP grid_resSEXP, SEXP edge_widthSEXP, SEXP nn_temperatureSEXP, SEXP k_nnSEXP, SEXP dbh_minSEXP, SEXP max_iterSEXP, SEXP n_roundsSEXP, SEXP memorySEXP, SEXP tolSEXP, SEXP n_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type dbh(dbhSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type species(speciesSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type dbh_grid(dbh_gridSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type height_tab(height_tabSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type radius_tab(radius_tabSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type fuel_tab(fuel_tabSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type target(targetSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type weight(weightSEXP);
+    Rcpp::traits::input_parameter< double >::type plot_size(plot_sizeSEXP);
+    Rcpp::traits::input_parameter< double >::type grid_res(grid_resSEXP);
+    Rcpp::traits::input_parameter< double >::type edge_width(edge_widthSEXP);
+    Rcpp::traits::input_parameter< double >::type nn_temperature(nn_temperatureSEXP);
+    Rcpp::traits::input_parameter< int >::type k_nn(k_nnSEXP);
+    Rcpp::traits::input_parameter< double >::type dbh_min(dbh_minSEXP);
+    Rcpp::traits::input_parameter< int >::type max_iter(max_iterSEXP);
+    Rcpp::traits::input_parameter< int >::type n_rounds(n_roundsSEXP);
+    Rcpp::traits::input_parameter< int >::type memory(memorySEXP);
+    Rcpp::traits::input_parameter< double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(polishStandCpp(x, y, dbh, species, dbh_grid, height_tab, radius_tab, fuel_tab, target, weight, plot_size, grid_res, edge_width, nn_temperature, k_nn, dbh_min, max_iter, n_rounds, memory, tol, n_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// projectStandsCpp
+List projectStandsCpp(IntegerVector start, IntegerVector n, NumericVector plot_size, NumericVector x, NumericVector y, NumericVector dbh, IntegerVector species, NumericMatrix allometry, int cbh_method, int foliage_method, List program, NumericMatrix growth, NumericMatrix mortality, IntegerVector seeds, int years, int record_every, double comp_radius, double grid_res, int cover_method, int n_threads, double progress, bool profile);
+RcppExport SEXP _EmpiricalPatternR_projectStandsCpp(SEXP startSEXP, SEXP nSEXP, SEXP plot_sizeSEXP, SEXP xSEXP, SEXP ySEXP, SEXP dbhSEXP, SEXP speciesSEXP, SEXP allometrySEXP, SEXP cbh_methodSEXP, SEXP foliage_methodSEXP, SEXP programSEXP, SEXP growthSEXP, SEXP mortalitySEXP, SEXP seedsSEXP, SEXP yearsSEXP, SEXP record_everySEXP, SEXP comp_radiusSEXP, SEXP grid_resSEXP, SEXP cover_methodSEXP, SEXP n_threadsSEXP, SEXP progressSEXP, SEXP profileSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< IntegerVector >::type start(startSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type n(nSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type plot_size(plot_sizeSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type dbh(dbhSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type species(speciesSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type allometry(allometrySEXP);
+    Rcpp::traits::input_parameter< int >::type cbh_method(cbh_methodSEXP);
+    Rcpp::traits::input_parameter< int >::type foliage_method(foliage_methodSEXP);
+    Rcpp::traits::input_parameter< List >::type program(programSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type growth(growthSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type mortality(mortalitySEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type seeds(seedsSEXP);
+    Rcpp::traits::input_parameter< int >::type years(yearsSEXP);
+    Rcpp::traits::input_parameter< int >::type record_every(record_everySEXP);
+    Rcpp::traits::input_parameter< double >::type comp_radius(comp_radiusSEXP);
+    Rcpp::traits::input_parameter< double >::type grid_res(grid_resSEXP);
+    Rcpp::traits::input_parameter< int >::type cover_method(cover_methodSEXP);
+    Rcpp::traits::input_parameter< int >::type n_threads(n_threadsSEXP);
+    Rcpp::traits::input_parameter< double >::type progress(progressSEXP);
+    Rcpp::traits::input_parameter< bool >::type profile(profileSEXP);
+    rcpp_result_gen = Rcpp::wrap(projectStandsCpp(start, n, plot_size, x, y, dbh, species, allometry, cbh_method, foliage_method, program, growth, mortality, seeds, years, record_every, comp_radius, grid_res, cover_method, n_threads, progress, profile));
+    return rcpp_result_gen;
+END_RCPP
+}
+// binSizeClassesCpp
+NumericMatrix binSizeClassesCpp(NumericVector values, IntegerVector species, int n_species, double origin, double width, int n_bins);
+RcppExport SEXP _EmpiricalPatternR_binSizeClassesCpp(SEXP valuesSEXP, SEXP speciesSEXP, SEXP n_speciesSEXP, SEXP originSEXP, SEXP widthSEXP, SEXP n_binsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type values(valuesSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type species(speciesSEXP);
+    Rcpp::traits::input_parameter< int >::type n_species(n_speciesSEXP);
+    Rcpp::traits::input_parameter< double >::type origin(originSEXP);
+    Rcpp::traits::input_parameter< double >::type width(widthSEXP);
+    Rcpp::traits::input_parameter< int >::type n_bins(n_binsSEXP);
+    rcpp_result_gen = Rcpp::wrap(binSizeClassesCpp(values, species, n_species, origin, width, n_bins));
+    return rcpp_result_gen;
+END_RCPP
+}
+// calcHistogramEnergyCpp
+double calcHistogramEnergyCpp(NumericMatrix observed, NumericMatrix target, std::string method);
+RcppExport SEXP _EmpiricalPatternR_calcHistogramEnergyCpp(SEXP observedSEXP, SEXP targetSEXP, SEXP methodSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericMatrix >::type observed(observedSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type target(targetSEXP);
+    Rcpp::traits::input_parameter< std::string >::type method(methodSEXP);
+    rcpp_result_gen = Rcpp::wrap(calcHistogramEnergyCpp(observed, target, method));
+    return rcpp_result_gen;
+END_RCPP
+}
+// standStoreCreate
+SEXP standStoreCreate(List trees);
+RcppExport SEXP _EmpiricalPatternR_standStoreCreate(SEXP treesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< List >::type trees(treesSEXP);
+    rcpp_result_gen = Rcpp::wrap(standStoreCreate(trees));
+    return rcpp_result_gen;
+END_RCPP
+}
+// standStoreSize
+int standStoreSize(SEXP store);
+RcppExport SEXP _EmpiricalPatternR_standStoreSize(SEXP storeSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type store(storeSEXP);
+    rcpp_result_gen = Rcpp::wrap(standStoreSize(store));
+    return rcpp_result_gen;
+END_RCPP
+}
+// standViewIsNative
+bool standViewIsNative(SEXP x);
+RcppExport SEXP _EmpiricalPatternR_standViewIsNative(SEXP xSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type x(xSEXP);
+    rcpp_result_gen = Rcpp::wrap(standViewIsNative(x));
+    return rcpp_result_gen;
+END_RCPP
+}
+// standStoreViews
+List standStoreViews(SEXP store);
+RcppExport SEXP _EmpiricalPatternR_standStoreViews(SEXP storeSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type store(storeSEXP);
+    rcpp_result_gen = Rcpp::wrap(standStoreViews(store));
+    return rcpp_result_gen;
+END_RCPP
+}
+// standStoreSetReal
+void standStoreSetReal(SEXP store, std::string column, IntegerVector i, NumericVector value);
+RcppExport SEXP _EmpiricalPatternR_standStoreSetReal(SEXP storeSEXP, SEXP columnSEXP, SEXP iSEXP, SEXP valueSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type store(storeSEXP);
+    Rcpp::traits::input_parameter< std::string >::type column(columnSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type i(iSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type value(valueSEXP);
+    standStoreSetReal(store, column, i, value);
+    return R_NilValue;
+END_RCPP
+}
+// readStemMapCpp
+List readStemMapCpp(std::string path, std::string x_col, std::string y_col, std::string dbh_col, std::string species_col, double tile_size, double x0, double y0, std::string sep);
+RcppExport SEXP _EmpiricalPatternR_readStemMapCpp(SEXP pathSEXP, SEXP x_colSEXP, SEXP y_colSEXP, SEXP dbh_colSEXP, SEXP species_colSEXP, SEXP tile_sizeSEXP, SEXP x0SEXP, SEXP y0SEXP, SEXP sepSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< std::string >::type x_col(x_colSEXP);
+    Rcpp::traits::input_parameter< std::string >::type y_col(y_colSEXP);
+    Rcpp::traits::input_parameter< std::string >::type dbh_col(dbh_colSEXP);
+    Rcpp::traits::input_parameter< std::string >::type species_col(species_colSEXP);
+    Rcpp::traits::input_parameter< double >::type tile_size(tile_sizeSEXP);
+    Rcpp::traits::input_parameter< double >::type x0(x0SEXP);
+    Rcpp::traits::input_parameter< double >::type y0(y0SEXP);
+    Rcpp::traits::input_parameter< std::string >::type sep(sepSEXP);
+    rcpp_result_gen = Rcpp::wrap(readStemMapCpp(path, x_col, y_col, dbh_col, species_col, tile_size, x0, y0, sep));
+    return rcpp_result_gen;
+END_RCPP
+}
+// calcTileMetricsCpp
+List calcTileMetricsCpp(IntegerVector start, IntegerVector n, NumericVector x, NumericVector y, NumericVector dbh, NumericVector height, NumericVector crown_radius, NumericVector crown_length, NumericVector fuel_mass, IntegerVector species, int n_species, double tile_size, double grid_res, int n_threads);
+RcppExport SEXP _EmpiricalPatternR_calcTileMetricsCpp(SEXP startSEXP, SEXP nSEXP, SEXP xSEXP, SEXP ySEXP, SEXP dbhSEXP, SEXP heightSEXP, SEXP crown_radiusSEXP, SEXP crown_lengthSEXP, SEXP fuel_massSEXP, SEXP speciesSEXP, SEXP n_speciesSEXP, SEXP tile_sizeSEXP, SEXP grid_resSEXP, SEXP n_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< IntegerVector >::type start(startSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type n(nSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type dbh(dbhSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type height(heightSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type crown_radius(crown_radiusSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type crown_length(crown_lengthSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type fuel_mass(fuel_massSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type species(speciesSEXP);
+    Rcpp::traits::input_parameter< int >::type n_species(n_speciesSEXP);
+    Rcpp::traits::input_parameter< double >::type tile_size(tile_sizeSEXP);
+    Rcpp::traits::input_parameter< double >::type grid_res(grid_resSEXP);
+    Rcpp::traits::input_parameter< int >::type n_threads(n_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(calcTileMetricsCpp(start, n, x, y, dbh, height, crown_radius, crown_length, fuel_mass, species, n_species, tile_size, grid_res, n_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// trajectoryLogInit
+SEXP trajectoryLogInit(IntegerVector number, NumericVector x, NumericVector y, IntegerVector species, NumericVector dbh, double coord_res, double dbh_res, int keyframe_every);
+RcppExport SEXP _EmpiricalPatternR_trajectoryLogInit(SEXP numberSEXP, SEXP xSEXP, SEXP ySEXP, SEXP speciesSEXP, SEXP dbhSEXP, SEXP coord_resSEXP, SEXP dbh_resSEXP, SEXP keyframe_everySEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< IntegerVector >::type number(numberSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type species(speciesSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type dbh(dbhSEXP);
+    Rcpp::traits::input_parameter< double >::type coord_res(coord_resSEXP);
+    Rcpp::traits::input_parameter< double >::type dbh_res(dbh_resSEXP);
+    Rcpp::traits::input_parameter< int >::type keyframe_every(keyframe_everySEXP);
+    rcpp_result_gen = Rcpp::wrap(trajectoryLogInit(number, x, y, species, dbh, coord_res, dbh_res, keyframe_every));
+    return rcpp_result_gen;
+END_RCPP
+}
+// trajectoryLogRecord
+void trajectoryLogRecord(SEXP log, int iter, int op, int number, double x, double y, int species, double dbh);
+RcppExport SEXP _EmpiricalPatternR_trajectoryLogRecord(SEXP logSEXP, SEXP iterSEXP, SEXP opSEXP, SEXP numberSEXP, SEXP xSEXP, SEXP ySEXP, SEXP speciesSEXP, SEXP dbhSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type log(logSEXP);
+    Rcpp::traits::input_parameter< int >::type iter(iterSEXP);
+    Rcpp::traits::input_parameter< int >::type op(opSEXP);
+    Rcpp::traits::input_parameter< int >::type number(numberSEXP);
+    Rcpp::traits::input_parameter< double >::type x(xSEXP);
+    Rcpp::traits::input_parameter< double >::type y(ySEXP);
+    Rcpp::traits::input_parameter< int >::type species(speciesSEXP);
+    Rcpp::traits::input_parameter< double >::type dbh(dbhSEXP);
+    trajectoryLogRecord(log, iter, op, number, x, y, species, dbh);
+    return R_NilValue;
+END_RCPP
+}
+// trajectoryLogStandAt
+List trajectoryLogStandAt(SEXP log, int iter);
+RcppExport SEXP _EmpiricalPatternR_trajectoryLogStandAt(SEXP logSEXP, SEXP iterSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type log(logSEXP);
+    Rcpp::traits::input_parameter< int >::type iter(iterSEXP);
+    rcpp_result_gen = Rcpp::wrap(trajectoryLogStandAt(log, iter));
+    return rcpp_result_gen;
+END_RCPP
+}
+// trajectoryLogInfo
+List trajectoryLogInfo(SEXP log);
+RcppExport SEXP _EmpiricalPatternR_trajectoryLogInfo(SEXP logSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type log(logSEXP);
+    rcpp_result_gen = Rcpp::wrap(trajectoryLogInfo(log));
+    return rcpp_result_gen;
+END_RCPP
+}
 
 static const R_CallMethodDef CallEntries[] = {
+    {"_EmpiricalPatternR_calcAllometryProgramCpp", (DL_FUNC) &_EmpiricalPatternR_calcAllometryProgramCpp, 6},
+    {"_EmpiricalPatternR_approxCanopyCoverCpp", (DL_FUNC) &_EmpiricalPatternR_approxCanopyCoverCpp, 9},
+    {"_EmpiricalPatternR_approxClarkEvansCpp", (DL_FUNC) &_EmpiricalPatternR_approxClarkEvansCpp, 7},
+    {"_EmpiricalPatternR_calcCanopyHeightCpp", (DL_FUNC) &_EmpiricalPatternR_calcCanopyHeightCpp, 13},
+    {"_EmpiricalPatternR_crownFireIndicesCpp", (DL_FUNC) &_EmpiricalPatternR_crownFireIndicesCpp, 13},
+    {"_EmpiricalPatternR_energyTermBuiltin", (DL_FUNC) &_EmpiricalPatternR_energyTermBuiltin, 3},
+    {"_EmpiricalPatternR_repairSeamsCpp", (DL_FUNC) &_EmpiricalPatternR_repairSeamsCpp, 13},
+    {"_EmpiricalPatternR_calcStandMetricsTasksCpp", (DL_FUNC) &_EmpiricalPatternR_calcStandMetricsTasksCpp, 14},
+    {"_EmpiricalPatternR_annealStandNativeCpp", (DL_FUNC) &_EmpiricalPatternR_annealStandNativeCpp, 23},
+    {"_EmpiricalPatternR_calcNNStatsCpp", (DL_FUNC) &_EmpiricalPatternR_calcNNStatsCpp, 7},
+    {"_EmpiricalPatternR_calcSpeciesCECpp", (DL_FUNC) &_EmpiricalPatternR_calcSpeciesCECpp, 7},
     {"_EmpiricalPatternR_calcCE", (DL_FUNC) &_EmpiricalPatternR_calcCE, 4},
     {"_EmpiricalPatternR_calcEnergy", (DL_FUNC) &_EmpiricalPatternR_calcEnergy, 2},
     {"_EmpiricalPatternR_estimateWeibullParams", (DL_FUNC) &_EmpiricalPatternR_estimateWeibullParams, 1},
     {"_EmpiricalPatternR_calcWeibullKS", (DL_FUNC) &_EmpiricalPatternR_calcWeibullKS, 4},
     {"_EmpiricalPatternR_calcWeibullEnergy", (DL_FUNC) &_EmpiricalPatternR_calcWeibullEnergy, 4},
     {"_EmpiricalPatternR_calcCanopyCoverCpp", (DL_FUNC) &_EmpiricalPatternR_calcCanopyCoverCpp, 5},
+    {"_EmpiricalPatternR_calcCanopyCoverEllipseCpp", (DL_FUNC) &_EmpiricalPatternR_calcCanopyCoverEllipseCpp, 9},
+    {"_EmpiricalPatternR_calcCanopyCoverIntervalCpp", (DL_FUNC) &_EmpiricalPatternR_calcCanopyCoverIntervalCpp, 5},
     {"_EmpiricalPatternR_calcNearestDistanceCpp", (DL_FUNC) &_EmpiricalPatternR_calcNearestDistanceCpp, 4},
     {"_EmpiricalPatternR_calcCrownRadiusCpp", (DL_FUNC) &_EmpiricalPatternR_calcCrownRadiusCpp, 3},
     {"_EmpiricalPatternR_calcHeightCpp", (DL_FUNC) &_EmpiricalPatternR_calcHeightCpp, 3},
     {"_EmpiricalPatternR_calcCrownBaseHeightCpp", (DL_FUNC) &_EmpiricalPatternR_calcCrownBaseHeightCpp, 4},
     {"_EmpiricalPatternR_calcCrownOverlapCpp", (DL_FUNC) &_EmpiricalPatternR_calcCrownOverlapCpp, 3},
+    {"_EmpiricalPatternR_calcCrownOverlapEllipseCpp", (DL_FUNC) &_EmpiricalPatternR_calcCrownOverlapEllipseCpp, 8},
     {"_EmpiricalPatternR_calcDistributionEnergy", (DL_FUNC) &_EmpiricalPatternR_calcDistributionEnergy, 3},
     {"_EmpiricalPatternR_calcCanopyCoverIndexedCpp", (DL_FUNC) &_EmpiricalPatternR_calcCanopyCoverIndexedCpp, 5},
     {"_EmpiricalPatternR_calcEnergyComponentsCpp", (DL_FUNC) &_EmpiricalPatternR_calcEnergyComponentsCpp, 4},
@@ -338,10 +879,27 @@ static const R_CallMethodDef CallEntries[] = {
     {"_EmpiricalPatternR_calcCEParallel", (DL_FUNC) &_EmpiricalPatternR_calcCEParallel, 5},
     {"_EmpiricalPatternR_getOpenMPInfo", (DL_FUNC) &_EmpiricalPatternR_getOpenMPInfo, 0},
     {"_EmpiricalPatternR_calcCanopyCoverHybrid", (DL_FUNC) &_EmpiricalPatternR_calcCanopyCoverHybrid, 6},
+    {"_EmpiricalPatternR_polishStandCpp", (DL_FUNC) &_EmpiricalPatternR_polishStandCpp, 21},
+    {"_EmpiricalPatternR_projectStandsCpp", (DL_FUNC) &_EmpiricalPatternR_projectStandsCpp, 22},
+    {"_EmpiricalPatternR_binSizeClassesCpp", (DL_FUNC) &_EmpiricalPatternR_binSizeClassesCpp, 6},
+    {"_EmpiricalPatternR_calcHistogramEnergyCpp", (DL_FUNC) &_EmpiricalPatternR_calcHistogramEnergyCpp, 3},
+    {"_EmpiricalPatternR_standStoreCreate", (DL_FUNC) &_EmpiricalPatternR_standStoreCreate, 1},
+    {"_EmpiricalPatternR_standStoreSize", (DL_FUNC) &_EmpiricalPatternR_standStoreSize, 1},
+    {"_EmpiricalPatternR_standViewIsNative", (DL_FUNC) &_EmpiricalPatternR_standViewIsNative, 1},
+    {"_EmpiricalPatternR_standStoreViews", (DL_FUNC) &_EmpiricalPatternR_standStoreViews, 1},
+    {"_EmpiricalPatternR_standStoreSetReal", (DL_FUNC) &_EmpiricalPatternR_standStoreSetReal, 4},
+    {"_EmpiricalPatternR_readStemMapCpp", (DL_FUNC) &_EmpiricalPatternR_readStemMapCpp, 9},
+    {"_EmpiricalPatternR_calcTileMetricsCpp", (DL_FUNC) &_EmpiricalPatternR_calcTileMetricsCpp, 14},
+    {"_EmpiricalPatternR_trajectoryLogInit", (DL_FUNC) &_EmpiricalPatternR_trajectoryLogInit, 8},
+    {"_EmpiricalPatternR_trajectoryLogRecord", (DL_FUNC) &_EmpiricalPatternR_trajectoryLogRecord, 8},
+    {"_EmpiricalPatternR_trajectoryLogStandAt", (DL_FUNC) &_EmpiricalPatternR_trajectoryLogStandAt, 2},
+    {"_EmpiricalPatternR_trajectoryLogInfo", (DL_FUNC) &_EmpiricalPatternR_trajectoryLogInfo, 1},
     {NULL, NULL, 0}
 };
 
+void registerStandViews(DllInfo* dll);
 RcppExport void R_init_EmpiricalPatternR(DllInfo *dll) {
     R_registerRoutines(dll, NULL, CallEntries, NULL, NULL);
     R_useDynamicSymbols(dll, FALSE);
+    registerStandViews(dll);
 }
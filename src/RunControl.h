@@ -0,0 +1,99 @@
+#ifndef EMPIRICALPATTERNR_RUNCONTROL_H
+#define EMPIRICALPATTERNR_RUNCONTROL_H
+
+#include <Rcpp.h>
+#include <atomic>
+#include <chrono>
+
+// ==============================================================================
+// RUN CONTROL: INTERRUPTS AND PROGRESS
+// ==============================================================================
+// checkUserInterrupt() unwinds the C++ stack, so a native run stopped with
+// Ctrl-C loses everything it has found. RunControl instead runs
+// R_CheckUserInterrupt under R_ToplevelExec, which reports the interrupt as a
+// return value: the loop sees stopped(), leaves normally and returns its best
+// state flagged as interrupted.
+//
+// poll() may be called every iteration: it reads the clock only every
+// `stride` calls and asks R about interrupts at most every poll_ms
+// milliseconds, so polling costs a counter increment in the common case. It
+// calls into R and must only run on R's main thread (thread 0 of an OpenMP
+// team). Progress is published through the atomic counters below, which any
+// thread may update without locking; poll() prints them as one status line,
+// rewritten in place, at most every report_sec seconds (0 = silent).
+
+static inline void runControlCheckInterrupt(void*) { R_CheckUserInterrupt(); }
+
+class RunControl {
+public:
+    std::atomic<long> done;        // work items (iterations, stands) finished
+    std::atomic<long> accepted;    // accepted proposals (annealing loops)
+    std::atomic<double> energy;    // current and best energy; NaN = not shown
+    std::atomic<double> best;
+
+    RunControl(const char* label, long total, double report_sec = 0.0, int stride = 64,
+               double poll_ms = 5.0)
+        : done(0), accepted(0), energy(R_NaReal), best(R_NaReal), label_(label),
+          total_(total), stride_(stride < 1 ? 1 : stride), calls_(0), reported_(false),
+          report_(report_sec > 0), stop_(false),
+          poll_every_(poll_ms / 1000.0), report_every_(report_sec) {
+        last_poll_ = last_report_ = Clock::now();
+    }
+
+    // Check for an interrupt and report if due; true once interrupted
+    bool poll() {
+        if(++calls_ < stride_) return stopped();
+        calls_ = 0;
+        Clock::time_point now = Clock::now();
+        if(now - last_poll_ >= poll_every_) {
+            last_poll_ = now;
+            if(!R_ToplevelExec(runControlCheckInterrupt, NULL)) stop();
+        }
+        if(report_ && now - last_report_ >= report_every_) {
+            last_report_ = now;
+            report();
+        }
+        return stopped();
+    }
+
+    void stop() { stop_.store(true, std::memory_order_relaxed); }
+    bool stopped() const { return stop_.load(std::memory_order_relaxed); }
+
+    // Final status line (if any was printed)
+    void finish() {
+        if(!reported_) return;
+        report();
+        Rprintf("\n");
+        R_FlushConsole();
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+    typedef std::chrono::duration<double> Seconds;
+
+    const char* label_;
+    long total_;
+    int stride_, calls_;
+    bool reported_, report_;
+    std::atomic<bool> stop_;
+    Seconds poll_every_, report_every_;
+    Clock::time_point last_poll_, last_report_;
+
+    void report() {
+        long d = done.load(std::memory_order_relaxed);
+        double e = energy.load(std::memory_order_relaxed);
+        double b = best.load(std::memory_order_relaxed);
+        Rprintf("\r%s: %ld / %ld (%.0f%%)", label_, d, total_,
+                total_ > 0 ? 100.0 * d / total_ : 0.0);
+        if(e == e) {
+            Rprintf("  energy %.4g  best %.4g  accepted %.1f%%", e, b,
+                    d > 0 ? 100.0 * accepted.load(std::memory_order_relaxed) / d : 0.0);
+        }
+        if(stopped()) Rprintf("  [interrupted]");
+        Rprintf("   ");
+        R_FlushConsole();
+        reported_ = true;
+    }
+};
+
+#endif
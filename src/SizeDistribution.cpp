@@ -0,0 +1,60 @@
+#include <Rcpp.h>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "SizeHistogram.h"
+
+using namespace Rcpp;
+using namespace std;
+
+// ==============================================================================
+// DBH AND HEIGHT CLASS DISTRIBUTION ENERGY
+// ==============================================================================
+// Mean and SD targets cannot express reverse-J or bimodal diameter
+// distributions. These kernels bin trees into fixed-width classes by species
+// (O(n), no sorting) and score the class counts against target tallies with
+// a chi-square or Wasserstein-1 distance in O(bins).
+
+static int histogramMethod(std::string method) {
+    if(method == "chisq") return HIST_CHISQ;
+    if(method == "wasserstein") return HIST_WASSERSTEIN;
+    stop("method must be 'chisq' or 'wasserstein'");
+    return -1;
+}
+
+// Class counts, n_bins x n_species (species are 1-based codes)
+// [[Rcpp::export]]
+NumericMatrix binSizeClassesCpp(NumericVector values, IntegerVector species,
+                                int n_species, double origin, double width,
+                                int n_bins) {
+    if(n_bins < 1 || width <= 0) stop("need n_bins >= 1 and width > 0");
+    SizeHistogram hist(origin, width, n_bins, n_species);
+    int n = values.size();
+    for(int i = 0; i < n; i++) {
+        int s = species[i] - 1;
+        if(s < 0 || s >= n_species) stop("species codes must be in 1..n_species");
+        hist.add(values[i], s);
+    }
+    NumericMatrix counts(n_bins, n_species);
+    for(int s = 0; s < n_species; s++) {
+        for(int k = 0; k < n_bins; k++) counts(k, s) = hist.count(k, s);
+    }
+    return counts;
+}
+
+// Mean distance over columns between observed and target class tables
+// [[Rcpp::export]]
+double calcHistogramEnergyCpp(NumericMatrix observed, NumericMatrix target,
+                              std::string method = "wasserstein") {
+    int m = histogramMethod(method);
+    int n_bins = observed.nrow(), n_cols = observed.ncol();
+    if(target.nrow() != n_bins || target.ncol() != n_cols) {
+        stop("observed and target must have the same dimensions");
+    }
+    if(n_cols == 0) return 0.0;
+    double total = 0.0;
+    for(int s = 0; s < n_cols; s++) {
+        total += histogramDistance(&observed(0, s), &target(0, s), n_bins, m);
+    }
+    return total / n_cols;
+}
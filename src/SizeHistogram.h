@@ -0,0 +1,130 @@
+#ifndef EMPIRICALPATTERNR_SIZEHISTOGRAM_H
+#define EMPIRICALPATTERNR_SIZEHISTOGRAM_H
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+// ==============================================================================
+// SIZE-CLASS HISTOGRAMS
+// ==============================================================================
+// Fixed-width size classes (e.g. 5 cm DBH classes) counted per species. The
+// first class starts at `origin`; values below it fall in the first class and
+// values beyond the last edge in the last (open-ended) class, as in field
+// tallies. Adding, removing or resizing a tree touches one or two counts, and
+// scoring against a target distribution costs O(bins) for each species whose
+// counts changed since the last score, with no sorting.
+
+enum HistogramMethod { HIST_CHISQ = 0, HIST_WASSERSTEIN = 1 };
+
+// Distance between two class distributions given as counts (normalized here).
+// HIST_CHISQ: symmetric chi-square sum (p - q)^2 / (p + q), in [0, 2].
+// HIST_WASSERSTEIN: earth mover's distance sum |P - Q| in class widths.
+// An empty side against a non-empty one is as far as the distance goes (2,
+// or n_bins - 1 class widths); two empty sides are at distance 0.
+inline double histogramDistance(const double* obs, const double* target, int n_bins,
+                                int method) {
+    double so = 0.0, st = 0.0;
+    for(int k = 0; k < n_bins; k++) {
+        so += obs[k];
+        st += target[k];
+    }
+    if(so <= 0.0 && st <= 0.0) return 0.0;
+    if(so <= 0.0 || st <= 0.0) return method == HIST_CHISQ ? 2.0 : (double)std::max(n_bins - 1, 0);
+
+    double d = 0.0;
+    if(method == HIST_CHISQ) {
+        for(int k = 0; k < n_bins; k++) {
+            double p = obs[k] / so, q = target[k] / st;
+            if(p + q > 0.0) d += (p - q) * (p - q) / (p + q);
+        }
+    } else {
+        double cp = 0.0, cq = 0.0;
+        for(int k = 0; k < n_bins - 1; k++) {
+            cp += obs[k] / so;
+            cq += target[k] / st;
+            d += std::fabs(cp - cq);
+        }
+    }
+    return d;
+}
+
+class SizeHistogram {
+public:
+    SizeHistogram(double origin, double width, int n_bins, int n_species) :
+        origin_(origin), width_(width), n_bins_(n_bins), n_species_(n_species),
+        method_(HIST_WASSERSTEIN), counts_(n_bins * n_species, 0.0),
+        target_(n_bins * n_species, 0.0), score_(n_species, 0.0),
+        dirty_(n_species, true) {}
+
+    // Target counts or proportions, column-major n_bins x n_species
+    void setTarget(const double* target, int method) {
+        std::copy(target, target + n_bins_ * n_species_, target_.begin());
+        method_ = method;
+        std::fill(dirty_.begin(), dirty_.end(), true);
+    }
+
+    // Empty all classes (the target is kept)
+    void clear() {
+        std::fill(counts_.begin(), counts_.end(), 0.0);
+        std::fill(dirty_.begin(), dirty_.end(), true);
+    }
+
+    int bins() const { return n_bins_; }
+    int species() const { return n_species_; }
+
+    // Class index of a value (clamped to the first/last class)
+    int bin(double value) const {
+        int k = (int)std::floor((value - origin_) / width_);
+        return std::max(0, std::min(k, n_bins_ - 1));
+    }
+
+    // Species s is 0-based; NaN values are ignored
+    void add(double value, int s) {
+        if(std::isnan(value)) return;
+        counts_[s * n_bins_ + bin(value)] += 1.0;
+        dirty_[s] = true;
+    }
+
+    void remove(double value, int s) {
+        if(std::isnan(value)) return;
+        counts_[s * n_bins_ + bin(value)] -= 1.0;
+        dirty_[s] = true;
+    }
+
+    // O(1) move of one tree between classes and/or species
+    void update(double old_value, int old_s, double new_value, int new_s) {
+        if(old_s == new_s && !std::isnan(old_value) && !std::isnan(new_value) &&
+           bin(old_value) == bin(new_value)) return;
+        remove(old_value, old_s);
+        add(new_value, new_s);
+    }
+
+    double count(int k, int s) const { return counts_[s * n_bins_ + k]; }
+
+    // Mean distance to the target over species. Only species whose counts
+    // changed since the last call are rescored.
+    double energy() {
+        double total = 0.0;
+        for(int s = 0; s < n_species_; s++) {
+            if(dirty_[s]) {
+                score_[s] = histogramDistance(&counts_[s * n_bins_], &target_[s * n_bins_],
+                                              n_bins_, method_);
+                dirty_[s] = false;
+            }
+            total += score_[s];
+        }
+        return n_species_ > 0 ? total / n_species_ : 0.0;
+    }
+
+private:
+    double origin_, width_;
+    int n_bins_, n_species_;
+    int method_;
+    std::vector<double> counts_;   // counts_[s * n_bins + k]
+    std::vector<double> target_;
+    std::vector<double> score_;
+    std::vector<bool> dirty_;
+};
+
+#endif
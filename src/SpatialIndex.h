@@ -0,0 +1,287 @@
+#ifndef EMPIRICALPATTERNR_SPATIALINDEX_H
+#define EMPIRICALPATTERNR_SPATIALINDEX_H
+
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+
+// ==============================================================================
+// TOROIDAL KD-TREE
+// ==============================================================================
+// Static 2-d tree over a periodic (toroidal) plot of size xmax x ymax, the same
+// edge correction used by calcCE (Illian et al. 2008, p. 184). Built once per
+// stand in O(n log n); each k-nearest-neighbour query is ~O(log n + k).
+// Queries are const and can run concurrently from OpenMP threads.
+
+class TorusKDTree {
+public:
+    TorusKDTree(const double* x, const double* y, int n, double xmax, double ymax) :
+        xmax_(xmax), ymax_(ymax), n_(n), px_(n), py_(n), id_(n) {
+        for(int i = 0; i < n; i++) id_[i] = i;
+        if(n > 0) {
+            nodes_.reserve(2 * (n / LEAF_SIZE + 1));
+            build(x, y, 0, n);
+        }
+        // Store coordinates in tree order so leaf scans are contiguous
+        for(int i = 0; i < n; i++) {
+            px_[i] = x[id_[i]];
+            py_[i] = y[id_[i]];
+        }
+    }
+
+    int size() const { return n_; }
+
+    // Squared toroidal distance between two points
+    double dist2(double x1, double y1, double x2, double y2) const {
+        double dx = wrap(fabs(x1 - x2), xmax_);
+        double dy = wrap(fabs(y1 - y2), ymax_);
+        return dx * dx + dy * dy;
+    }
+
+    // Find the k nearest neighbours of (qx, qy), skipping point `self`
+    // (-1 to skip nothing). Fills d2 (squared distances, ascending) and idx
+    // (original point indices); returns the number found (< k if n is small).
+    int knn(double qx, double qy, int k, int self, double* d2, int* idx) const {
+        int found = 0;
+        if(n_ == 0 || k <= 0) return 0;
+        search(0, qx, qy, k, self, d2, idx, found);
+        return found;
+    }
+
+    // Squared distance to the nearest neighbour of (qx, qy), or `none` if the
+    // tree holds no other point
+    double nearest2(double qx, double qy, int self, double none) const {
+        double d2;
+        int idx;
+        return knn(qx, qy, 1, self, &d2, &idx) == 1 ? d2 : none;
+    }
+
+private:
+    static const int LEAF_SIZE = 8;
+
+    struct Node {
+        int begin, end;          // range in px_/py_/id_
+        int left, right;         // child node indices (-1 for leaves)
+        double xlo, xhi, ylo, yhi;
+    };
+
+    double xmax_, ymax_;
+    int n_;
+    std::vector<double> px_, py_;
+    std::vector<int> id_;
+    std::vector<Node> nodes_;
+
+    static double wrap(double d, double len) {
+        return std::min(d, len - d);
+    }
+
+    int build(const double* x, const double* y, int begin, int end) {
+        Node node;
+        node.begin = begin;
+        node.end = end;
+        node.left = node.right = -1;
+        node.xlo = node.ylo = INFINITY;
+        node.xhi = node.yhi = -INFINITY;
+        for(int i = begin; i < end; i++) {
+            node.xlo = std::min(node.xlo, x[id_[i]]);
+            node.xhi = std::max(node.xhi, x[id_[i]]);
+            node.ylo = std::min(node.ylo, y[id_[i]]);
+            node.yhi = std::max(node.yhi, y[id_[i]]);
+        }
+        int self = (int)nodes_.size();
+        nodes_.push_back(node);
+
+        if(end - begin > LEAF_SIZE) {
+            // Split at the median of the wider extent
+            const double* key = (node.xhi - node.xlo) >= (node.yhi - node.ylo) ? x : y;
+            int mid = begin + (end - begin) / 2;
+            std::nth_element(id_.begin() + begin, id_.begin() + mid, id_.begin() + end,
+                             [key](int a, int b) { return key[a] < key[b]; });
+            int l = build(x, y, begin, mid);
+            int r = build(x, y, mid, end);
+            nodes_[self].left = l;
+            nodes_[self].right = r;
+        }
+        return self;
+    }
+
+    // Minimum squared toroidal distance from (qx, qy) to a node's bounding box
+    double boxDist2(const Node& node, double qx, double qy) const {
+        double dx = 0.0, dy = 0.0;
+        if(qx < node.xlo || qx > node.xhi) {
+            dx = std::min(wrap(fabs(qx - node.xlo), xmax_), wrap(fabs(qx - node.xhi), xmax_));
+        }
+        if(qy < node.ylo || qy > node.yhi) {
+            dy = std::min(wrap(fabs(qy - node.ylo), ymax_), wrap(fabs(qy - node.yhi), ymax_));
+        }
+        return dx * dx + dy * dy;
+    }
+
+    // Insert a candidate into the ascending k-best list
+    static void offer(double d, int id, int k, double* d2, int* idx, int& found) {
+        if(found == k && d >= d2[k - 1]) return;
+        int pos = (found < k) ? found++ : k - 1;
+        while(pos > 0 && d2[pos - 1] > d) {
+            d2[pos] = d2[pos - 1];
+            idx[pos] = idx[pos - 1];
+            pos--;
+        }
+        d2[pos] = d;
+        idx[pos] = id;
+    }
+
+    void search(int ni, double qx, double qy, int k, int self,
+                double* d2, int* idx, int& found) const {
+        const Node& node = nodes_[ni];
+        if(found == k && boxDist2(node, qx, qy) >= d2[k - 1]) return;
+
+        if(node.left < 0) {
+            for(int i = node.begin; i < node.end; i++) {
+                if(id_[i] == self) continue;
+                offer(dist2(qx, qy, px_[i], py_[i]), id_[i], k, d2, idx, found);
+            }
+            return;
+        }
+
+        // Visit the closer child first so the k-best bound tightens early
+        double dl = boxDist2(nodes_[node.left], qx, qy);
+        double dr = boxDist2(nodes_[node.right], qx, qy);
+        if(dl <= dr) {
+            search(node.left, qx, qy, k, self, d2, idx, found);
+            search(node.right, qx, qy, k, self, d2, idx, found);
+        } else {
+            search(node.right, qx, qy, k, self, d2, idx, found);
+            search(node.left, qx, qy, k, self, d2, idx, found);
+        }
+    }
+};
+
+// ==============================================================================
+// DYNAMIC CELL GRID
+// ==============================================================================
+// Uniform grid of cells over a width x height plot for points that move,
+// appear and disappear (annealing), where a static kd-tree would have to be
+// rebuilt. Points are indices 0..n-1 with their own coordinates; a move or
+// removal is O(1). Cells wrap around the plot edges; distances are toroidal,
+// or Euclidean with torus = false (the wrapped cells are then searched too,
+// which only costs time). With cells about the mean spacing of the points, a
+// nearest-point query or a collect within a few spacings visits a handful of
+// cells whatever n is.
+
+class TorusGrid {
+public:
+    TorusGrid(double width, double height, double cell, int n, bool torus = true)
+        : w_(width), h_(height), torus_(torus), x_(n, 0.0), y_(n, 0.0),
+          cell_of_(n, -1), slot_(n, -1) {
+        gx_ = std::max(1, (int)(width / cell));
+        gy_ = std::max(1, (int)(height / cell));
+        cw_ = width / gx_;
+        ch_ = height / gy_;
+        cells_.resize((size_t)gx_ * gy_);
+    }
+
+    double x(int i) const { return x_[i]; }
+    double y(int i) const { return y_[i]; }
+    bool contains(int i) const { return cell_of_[i] >= 0; }
+
+    double dist(int i, double px, double py) const {
+        if(!torus_) return hypot(x_[i] - px, y_[i] - py);
+        double dx = fabs(x_[i] - px), dy = fabs(y_[i] - py);
+        dx = std::min(dx, w_ - dx);
+        dy = std::min(dy, h_ - dy);
+        return sqrt(dx * dx + dy * dy);
+    }
+
+    void insert(int i, double px, double py) {
+        x_[i] = px;
+        y_[i] = py;
+        int c = cellY(py) * gx_ + cellX(px);
+        cell_of_[i] = c;
+        slot_[i] = (int)cells_[c].size();
+        cells_[c].push_back(i);
+    }
+
+    void remove(int i) {
+        std::vector<int>& c = cells_[cell_of_[i]];
+        int last = c.back();
+        c[slot_[i]] = last;
+        slot_[last] = slot_[i];
+        c.pop_back();
+        cell_of_[i] = -1;
+    }
+
+    void move(int i, double px, double py) {
+        remove(i);
+        insert(i, px, py);
+    }
+
+    // Nearest point to (px, py) other than `self`: rings of cells until no
+    // closer point can lie in the next ring. idx is -1 (and the result
+    // `none`) for an empty grid.
+    double nearest(double px, double py, int self, int& idx, double none = 1e300) const {
+        double best = none;
+        idx = -1;
+        int cx = cellX(px), cy = cellY(py);
+        int r_max = std::max(gx_, gy_);
+        for(int r = 0; r <= r_max; r++) {
+            for(int dy = -r; dy <= r; dy++) {
+                for(int dx = -r; dx <= r; dx++) {
+                    if(std::max(abs(dx), abs(dy)) != r) continue;
+                    const std::vector<int>& c = cell(cx + dx, cy + dy);
+                    for(size_t k = 0; k < c.size(); k++) {
+                        int j = c[k];
+                        if(j == self) continue;
+                        double d = dist(j, px, py);
+                        if(d < best) {
+                            best = d;
+                            idx = j;
+                        }
+                    }
+                }
+            }
+            if(idx >= 0 && best <= r * std::min(cw_, ch_)) break;
+        }
+        return best;
+    }
+
+    double nearest(int i, int& idx) const { return nearest(x_[i], y_[i], i, idx); }
+
+    // Appends to `out` the points in the cells within `radius` of (px, py)
+    // that are not yet marked with `mark` in stamp, and marks them
+    void collect(double px, double py, double radius, std::vector<int>& stamp, int mark,
+                 std::vector<int>& out) const {
+        int rx = radius < w_ ? std::min((int)ceil(radius / cw_), gx_ / 2 + 1) : gx_ / 2 + 1;
+        int ry = radius < h_ ? std::min((int)ceil(radius / ch_), gy_ / 2 + 1) : gy_ / 2 + 1;
+        int cx = cellX(px), cy = cellY(py);
+        for(int dy = -ry; dy <= ry; dy++) {
+            for(int dx = -rx; dx <= rx; dx++) {
+                const std::vector<int>& c = cell(cx + dx, cy + dy);
+                for(size_t k = 0; k < c.size(); k++) {
+                    if(stamp[c[k]] == mark) continue;
+                    stamp[c[k]] = mark;
+                    out.push_back(c[k]);
+                }
+            }
+        }
+    }
+
+private:
+    double w_, h_, cw_, ch_;
+    bool torus_;
+    int gx_, gy_;
+    std::vector<double> x_, y_;
+    std::vector<std::vector<int> > cells_;
+    std::vector<int> cell_of_, slot_;
+
+    int cellX(double px) const { return std::min(gx_ - 1, std::max(0, (int)(px / cw_))); }
+    int cellY(double py) const { return std::min(gy_ - 1, std::max(0, (int)(py / ch_))); }
+
+    const std::vector<int>& cell(int cx, int cy) const {
+        cx = ((cx % gx_) + gx_) % gx_;
+        cy = ((cy % gy_) + gy_) % gy_;
+        return cells_[(size_t)cy * gx_ + cx];
+    }
+};
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef EMPIRICALPATTERNR_STANDRNG_H
+#define EMPIRICALPATTERNR_STANDRNG_H
+
+#include <stdint.h>
+
+// ==============================================================================
+// SEEDED RANDOM STREAMS
+// ==============================================================================
+// Small generator for native kernels that need their own reproducible stream
+// (one per stand, or one per metric evaluation) without touching R's RNG
+// state, so results do not depend on thread count or call order.
+
+// SplitMix64-seeded xorshift generator; uniform doubles in [0, 1)
+struct StandRNG {
+    uint64_t s;
+    explicit StandRNG(uint64_t seed) : s(seed * 0x9E3779B97F4A7C15ULL + 0x632BE59BD9B4E019ULL) {}
+    double uniform() {
+        uint64_t z = (s += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        z ^= z >> 31;
+        return (z >> 11) * (1.0 / 9007199254740992.0);
+    }
+};
+
+#endif
@@ -0,0 +1,248 @@
+#include <Rcpp.h>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "StandStore.h"
+
+extern "C" {
+#include <R_ext/Altrep.h>
+}
+
+using namespace Rcpp;
+using namespace std;
+
+// ==============================================================================
+// ALTREP VIEWS OF THE NATIVE STAND STORE
+// ==============================================================================
+// Each view is an ALTREP real/integer vector whose data1 slot holds
+// list(store external pointer, column index, length). Element, region and
+// data pointer access all go straight to native memory, including the
+// writable pointers that data.table and most C code ask for while only
+// reading, so views never copy a column.
+//
+// R's copy-on-modify still applies: assigning into a view held by more than
+// one binding (x <- view$DBH; x[1] <- 0) duplicates it into an ordinary
+// vector first. Code that modifies vectors by reference (data.table::set,
+// := with i, C code writing through REAL()) writes to the store itself.
+// Duplicate (copy()) gives an independent ordinary vector.
+
+static R_altrep_class_t stand_real_class;
+static R_altrep_class_t stand_integer_class;
+
+static StandStore* viewStore(SEXP x) {
+    SEXP ptr = VECTOR_ELT(R_altrep_data1(x), 0);
+    StandStore* store = (StandStore*)R_ExternalPtrAddr(ptr);
+    if(store == NULL) Rf_error("stand store has been released");
+    return store;
+}
+
+static R_xlen_t viewLength(SEXP x) {
+    return (R_xlen_t)REAL(VECTOR_ELT(R_altrep_data1(x), 2))[0];
+}
+
+static StandColumn& viewColumn(SEXP x) {
+    StandStore* store = viewStore(x);
+    int j = INTEGER(VECTOR_ELT(R_altrep_data1(x), 1))[0];
+    StandColumn& col = store->columns[j];
+    if(col.size() < viewLength(x)) {
+        Rf_error("stand view of '%s' is stale (store was resized)", col.name.c_str());
+    }
+    return col;
+}
+
+static void* viewNative(SEXP x) {
+    StandColumn& col = viewColumn(x);
+    return col.type == StandColumn::REAL ? (void*)col.real.data() : (void*)col.integer.data();
+}
+
+// ---- ALTREP methods -----------------------------------------------------------
+
+static R_xlen_t standViewLength(SEXP x) { return viewLength(x); }
+
+static void* standViewDataptr(SEXP x, Rboolean /* writeable */) { return viewNative(x); }
+
+static const void* standViewDataptrOrNull(SEXP x) { return viewNative(x); }
+
+// Copy of the column as an ordinary R vector
+static SEXP standViewDuplicate(SEXP x, Rboolean /* deep */) {
+    R_xlen_t n = viewLength(x);
+    StandColumn& col = viewColumn(x);
+    SEXP out;
+    if(col.type == StandColumn::REAL) {
+        out = PROTECT(Rf_allocVector(REALSXP, n));
+        if(n > 0) memcpy(REAL(out), col.real.data(), n * sizeof(double));
+    } else {
+        out = PROTECT(Rf_allocVector(INTSXP, n));
+        if(n > 0) memcpy(INTEGER(out), col.integer.data(), n * sizeof(int));
+    }
+    UNPROTECT(1);
+    return out;
+}
+
+static Rboolean standViewInspect(SEXP x, int /* pre */, int /* deep */, int /* pvec */,
+                                 void (* /* inspect_subtree */)(SEXP, int, int, int)) {
+    Rprintf(" stand view '%s' (native, %d)\n", viewColumn(x).name.c_str(), (int)viewLength(x));
+    return TRUE;
+}
+
+static double standRealElt(SEXP x, R_xlen_t i) { return viewColumn(x).real[i]; }
+
+static R_xlen_t standRealGetRegion(SEXP x, R_xlen_t i, R_xlen_t n, double* buf) {
+    R_xlen_t m = std::min(n, viewLength(x) - i);
+    if(m <= 0) return 0;
+    memcpy(buf, viewColumn(x).real.data() + i, m * sizeof(double));
+    return m;
+}
+
+static int standIntegerElt(SEXP x, R_xlen_t i) { return viewColumn(x).integer[i]; }
+
+static R_xlen_t standIntegerGetRegion(SEXP x, R_xlen_t i, R_xlen_t n, int* buf) {
+    R_xlen_t m = std::min(n, viewLength(x) - i);
+    if(m <= 0) return 0;
+    memcpy(buf, viewColumn(x).integer.data() + i, m * sizeof(int));
+    return m;
+}
+
+// [[Rcpp::init]]
+void registerStandViews(DllInfo* dll) {
+    stand_real_class = R_make_altreal_class("stand_real", "EmpiricalPatternR", dll);
+    R_set_altrep_Length_method(stand_real_class, standViewLength);
+    R_set_altrep_Inspect_method(stand_real_class, standViewInspect);
+    R_set_altrep_Duplicate_method(stand_real_class, standViewDuplicate);
+    R_set_altvec_Dataptr_method(stand_real_class, standViewDataptr);
+    R_set_altvec_Dataptr_or_null_method(stand_real_class, standViewDataptrOrNull);
+    R_set_altreal_Elt_method(stand_real_class, standRealElt);
+    R_set_altreal_Get_region_method(stand_real_class, standRealGetRegion);
+
+    stand_integer_class = R_make_altinteger_class("stand_integer", "EmpiricalPatternR", dll);
+    R_set_altrep_Length_method(stand_integer_class, standViewLength);
+    R_set_altrep_Inspect_method(stand_integer_class, standViewInspect);
+    R_set_altrep_Duplicate_method(stand_integer_class, standViewDuplicate);
+    R_set_altvec_Dataptr_method(stand_integer_class, standViewDataptr);
+    R_set_altvec_Dataptr_or_null_method(stand_integer_class, standViewDataptrOrNull);
+    R_set_altinteger_Elt_method(stand_integer_class, standIntegerElt);
+    R_set_altinteger_Get_region_method(stand_integer_class, standIntegerGetRegion);
+}
+
+// ==============================================================================
+// STORE CONSTRUCTION AND ACCESS
+// ==============================================================================
+
+SEXP wrapStandStore(StandStore* store) {
+    XPtr<StandStore> ptr(store, true);
+    ptr.attr("class") = "stand_store";
+    return ptr;
+}
+
+// Copy a tree list (data.frame / data.table) into a new native store.
+// Numeric columns become REAL, integer columns INTEGER and character or
+// factor columns FACTOR (levels sorted as in factor()). Other column types
+// are skipped with a warning.
+// [[Rcpp::export]]
+SEXP standStoreCreate(List trees) {
+    SEXP out = PROTECT(wrapStandStore(new StandStore()));
+    StandStore* store = (StandStore*)R_ExternalPtrAddr(out);
+    CharacterVector names = trees.names();
+
+    for(int j = 0; j < trees.size(); j++) {
+        SEXP v = trees[j];
+        StandColumn col;
+        col.name = as<std::string>(names[j]);
+        R_xlen_t n = XLENGTH(v);
+
+        if(Rf_isFactor(v)) {
+            col.type = StandColumn::FACTOR;
+            col.integer.assign(INTEGER(v), INTEGER(v) + n);
+            CharacterVector lev = Rf_getAttrib(v, R_LevelsSymbol);
+            for(int k = 0; k < lev.size(); k++) col.levels.push_back(as<std::string>(lev[k]));
+        } else if(TYPEOF(v) == STRSXP) {
+            col.type = StandColumn::FACTOR;
+            CharacterVector s(v);
+            std::vector<std::string> values(n);
+            for(R_xlen_t i = 0; i < n; i++) values[i] = as<std::string>(s[i]);
+            col.levels = values;
+            std::sort(col.levels.begin(), col.levels.end());
+            col.levels.erase(std::unique(col.levels.begin(), col.levels.end()),
+                             col.levels.end());
+            col.integer.resize(n);
+            for(R_xlen_t i = 0; i < n; i++) {
+                col.integer[i] = (int)(std::lower_bound(col.levels.begin(), col.levels.end(),
+                                                        values[i]) - col.levels.begin()) + 1;
+            }
+        } else if(TYPEOF(v) == REALSXP) {
+            col.type = StandColumn::REAL;
+            col.real.assign(REAL(v), REAL(v) + n);
+        } else if(TYPEOF(v) == INTSXP) {
+            col.type = StandColumn::INTEGER;
+            col.integer.assign(INTEGER(v), INTEGER(v) + n);
+        } else {
+            warning("column '%s' has an unsupported type and is not stored", col.name);
+            continue;
+        }
+        store->columns.push_back(col);
+    }
+    UNPROTECT(1);
+    return out;
+}
+
+// [[Rcpp::export]]
+int standStoreSize(SEXP store) {
+    XPtr<StandStore> ptr(store);
+    return ptr->size();
+}
+
+// Whether x is a view of a stand store
+// [[Rcpp::export]]
+bool standViewIsNative(SEXP x) {
+    return ALTREP(x) && (R_altrep_inherits(x, stand_real_class) ||
+                         R_altrep_inherits(x, stand_integer_class));
+}
+
+// Named list of ALTREP views over every stored column
+// [[Rcpp::export]]
+List standStoreViews(SEXP store) {
+    XPtr<StandStore> ptr(store);
+    int nc = (int)ptr->columns.size();
+    List out(nc);
+    CharacterVector names(nc);
+
+    for(int j = 0; j < nc; j++) {
+        StandColumn& col = ptr->columns[j];
+        SEXP data1 = PROTECT(Rf_allocVector(VECSXP, 3));
+        SET_VECTOR_ELT(data1, 0, store);
+        SET_VECTOR_ELT(data1, 1, Rf_ScalarInteger(j));
+        SET_VECTOR_ELT(data1, 2, Rf_ScalarReal((double)col.size()));
+        R_altrep_class_t cls = col.type == StandColumn::REAL ? stand_real_class
+                                                             : stand_integer_class;
+        SEXP view = PROTECT(R_new_altrep(cls, data1, R_NilValue));
+        if(col.type == StandColumn::FACTOR) {
+            CharacterVector lev(col.levels.begin(), col.levels.end());
+            Rf_setAttrib(view, R_LevelsSymbol, lev);
+            Rf_setAttrib(view, R_ClassSymbol, Rf_mkString("factor"));
+        }
+        out[j] = view;
+        names[j] = col.name;
+        UNPROTECT(2);
+    }
+    out.attr("names") = names;
+    return out;
+}
+
+// Overwrite elements of a numeric column in native memory (1-based rows);
+// existing views see the new values
+// [[Rcpp::export]]
+void standStoreSetReal(SEXP store, std::string column, IntegerVector i,
+                       NumericVector value) {
+    XPtr<StandStore> ptr(store);
+    int j = ptr->find(column);
+    if(j < 0 || ptr->columns[j].type != StandColumn::REAL) {
+        stop("no numeric column '%s' in the stand store", column);
+    }
+    if(value.size() != i.size()) stop("i and value must have the same length");
+    std::vector<double>& v = ptr->columns[j].real;
+    for(int k = 0; k < i.size(); k++) {
+        if(i[k] < 1 || i[k] > (int)v.size()) stop("row index out of range");
+        v[i[k] - 1] = value[k];
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef EMPIRICALPATTERNR_STANDSTORE_H
+#define EMPIRICALPATTERNR_STANDSTORE_H
+
+#include <Rcpp.h>
+#include <string>
+#include <vector>
+
+// ==============================================================================
+// NATIVE STAND STORE
+// ==============================================================================
+// Column-oriented tree list owned by C++: a copy of an R tree list, or the
+// output of a native routine (anneal_stand_native, project_stands). Numeric
+// columns are kept as doubles, integer columns as ints and character/factor
+// columns (Species) as 1-based factor codes with their levels. R sees the
+// columns through ALTREP views that read native memory (StandStore.cpp).
+
+struct StandColumn {
+    enum Type { REAL, INTEGER, FACTOR };
+
+    std::string name;
+    Type type;
+    std::vector<double> real;             // REAL
+    std::vector<int> integer;             // INTEGER and FACTOR codes
+    std::vector<std::string> levels;      // FACTOR
+
+    int size() const {
+        return type == REAL ? (int)real.size() : (int)integer.size();
+    }
+};
+
+class StandStore {
+public:
+    std::vector<StandColumn> columns;
+
+    int size() const { return columns.empty() ? 0 : columns[0].size(); }
+
+    // Append a column of n zeros. References to columns are invalidated by
+    // later calls; add every column before taking pointers into them.
+    StandColumn& add(const std::string& name, StandColumn::Type type, int n) {
+        columns.push_back(StandColumn());
+        StandColumn& col = columns.back();
+        col.name = name;
+        col.type = type;
+        if(type == StandColumn::REAL) col.real.assign(n, 0.0);
+        else col.integer.assign(n, 0);
+        return col;
+    }
+
+    double* real(const std::string& name) { return columns[find(name)].real.data(); }
+    int* integer(const std::string& name) { return columns[find(name)].integer.data(); }
+
+    double bytes() const {
+        double b = 0.0;
+        for(size_t j = 0; j < columns.size(); j++) {
+            b += (double)columns[j].real.capacity() * sizeof(double) +
+                 (double)columns[j].integer.capacity() * sizeof(int);
+        }
+        return b;
+    }
+
+    // Column index by name, or -1 if absent
+    int find(const std::string& name) const {
+        for(size_t j = 0; j < columns.size(); j++) {
+            if(columns[j].name == name) return (int)j;
+        }
+        return -1;
+    }
+};
+
+// Hand a store to R as a "stand_store" external pointer; R owns it from here
+SEXP wrapStandStore(StandStore* store);
+
+#endif
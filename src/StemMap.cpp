@@ -0,0 +1,298 @@
+#include <Rcpp.h>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "SpatialIndex.h"
+#include "CanopyCover.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace Rcpp;
+using namespace std;
+
+// ==============================================================================
+// STREAMING STEM-MAP READER
+// ==============================================================================
+// Reads a delimited stem map (one tree per line, header row) without building
+// an R data.frame of strings. Each stem is assigned to a square tile of side
+// tile_size anchored at (x0, y0) as it is read; only the four needed columns
+// are parsed. Stems are returned grouped by tile (tiles ordered by row, then
+// column) with coordinates local to their tile, ready for per-plot metrics.
+
+// Split one line on `sep` (sep == '\0': any run of spaces/tabs), stripping
+// surrounding double quotes from each field
+static void splitLine(const string& line, char sep, vector<string>& fields) {
+    fields.clear();
+    size_t i = 0, n = line.size();
+    if(n > 0 && line[n - 1] == '\r') n--;
+    while(i <= n) {
+        if(sep == '\0') {
+            while(i < n && (line[i] == ' ' || line[i] == '\t')) i++;
+            if(i >= n) break;
+        }
+        size_t j = i;
+        while(j < n && (sep == '\0' ? (line[j] != ' ' && line[j] != '\t') : line[j] != sep)) j++;
+        string f = line.substr(i, j - i);
+        if(f.size() >= 2 && f[0] == '"' && f[f.size() - 1] == '"') f = f.substr(1, f.size() - 2);
+        fields.push_back(f);
+        i = j + 1;
+    }
+}
+
+static bool parseDouble(const string& s, double& out) {
+    if(s.empty()) return false;
+    char* end;
+    out = strtod(s.c_str(), &end);
+    return end != s.c_str() && std::isfinite(out);
+}
+
+struct TileStems {
+    vector<double> x, y, dbh;
+    vector<int> species;
+};
+
+// [[Rcpp::export]]
+List readStemMapCpp(std::string path, std::string x_col, std::string y_col,
+                    std::string dbh_col, std::string species_col,
+                    double tile_size, double x0 = 0.0, double y0 = 0.0,
+                    std::string sep = ",") {
+    if(tile_size <= 0) stop("tile_size must be positive");
+    char sepc = sep.empty() ? '\0' : sep[0];
+
+    ifstream in(path.c_str());
+    if(!in) stop("cannot open stem map file '%s'", path);
+
+    string line;
+    vector<string> fields;
+    if(!getline(in, line)) stop("stem map file '%s' is empty", path);
+    splitLine(line, sepc, fields);
+
+    int cx = -1, cy = -1, cd = -1, cs = -1;
+    for(int j = 0; j < (int)fields.size(); j++) {
+        if(fields[j] == x_col) cx = j;
+        if(fields[j] == y_col) cy = j;
+        if(fields[j] == dbh_col) cd = j;
+        if(fields[j] == species_col) cs = j;
+    }
+    if(cx < 0 || cy < 0 || cd < 0 || cs < 0) {
+        stop("stem map header must contain columns '%s', '%s', '%s' and '%s'",
+             x_col, y_col, dbh_col, species_col);
+    }
+    int need = max(max(cx, cy), max(cd, cs));
+
+    // Tiles keyed by (row, column) so the output order is deterministic
+    map<pair<long, long>, int> tile_index;
+    vector<TileStems> tiles;
+    map<string, int> species_codes;   // first-seen code per label
+    vector<string> species_seen;
+
+    long n_read = 0, n_skipped = 0;
+    while(getline(in, line)) {
+        if(line.empty()) continue;
+        if((++n_read & 0xFFFF) == 0) checkUserInterrupt();
+        splitLine(line, sepc, fields);
+        double x, y, dbh;
+        if((int)fields.size() <= need || !parseDouble(fields[cx], x) ||
+           !parseDouble(fields[cy], y) || !parseDouble(fields[cd], dbh)) {
+            n_skipped++;
+            continue;
+        }
+
+        const string& sp = fields[cs];
+        map<string, int>::iterator it = species_codes.find(sp);
+        int code;
+        if(it == species_codes.end()) {
+            code = (int)species_seen.size();
+            species_codes[sp] = code;
+            species_seen.push_back(sp);
+        } else {
+            code = it->second;
+        }
+
+        long ix = (long)floor((x - x0) / tile_size);
+        long iy = (long)floor((y - y0) / tile_size);
+        pair<long, long> key(iy, ix);
+        map<pair<long, long>, int>::iterator t = tile_index.find(key);
+        int ti;
+        if(t == tile_index.end()) {
+            ti = (int)tiles.size();
+            tile_index[key] = ti;
+            tiles.push_back(TileStems());
+        } else {
+            ti = t->second;
+        }
+        TileStems& ts = tiles[ti];
+        ts.x.push_back(x - x0 - ix * tile_size);
+        ts.y.push_back(y - y0 - iy * tile_size);
+        ts.dbh.push_back(dbh);
+        ts.species.push_back(code);
+    }
+
+    // Species levels sorted as factor() would, codes remapped to 1-based
+    vector<string> levels = species_seen;
+    sort(levels.begin(), levels.end());
+    vector<int> remap(species_seen.size());
+    for(size_t k = 0; k < species_seen.size(); k++) {
+        remap[k] = (int)(lower_bound(levels.begin(), levels.end(), species_seen[k]) -
+                         levels.begin()) + 1;
+    }
+
+    // Flatten in tile order
+    int n_tiles = (int)tiles.size();
+    long n_stems = 0;
+    for(int t = 0; t < n_tiles; t++) n_stems += tiles[t].x.size();
+
+    NumericVector sx(n_stems), sy(n_stems), sd(n_stems);
+    IntegerVector ss(n_stems), stile(n_stems);
+    IntegerVector tile_id(n_tiles), tile_row(n_tiles), tile_col(n_tiles),
+                  tile_n(n_tiles), tile_start(n_tiles);
+    NumericVector tile_x0(n_tiles), tile_y0(n_tiles);
+
+    long pos = 0;
+    int id = 0;
+    for(map<pair<long, long>, int>::iterator t = tile_index.begin(); t != tile_index.end(); ++t) {
+        TileStems& ts = tiles[t->second];
+        tile_id[id] = id + 1;
+        tile_row[id] = (int)t->first.first;
+        tile_col[id] = (int)t->first.second;
+        tile_x0[id] = x0 + t->first.second * tile_size;
+        tile_y0[id] = y0 + t->first.first * tile_size;
+        tile_n[id] = (int)ts.x.size();
+        tile_start[id] = (int)pos;
+        for(size_t k = 0; k < ts.x.size(); k++, pos++) {
+            sx[pos] = ts.x[k];
+            sy[pos] = ts.y[k];
+            sd[pos] = ts.dbh[k];
+            ss[pos] = remap[ts.species[k]];
+            stile[pos] = id + 1;
+        }
+        // Release tile memory as we go
+        vector<double>().swap(ts.x);
+        vector<double>().swap(ts.y);
+        vector<double>().swap(ts.dbh);
+        vector<int>().swap(ts.species);
+        id++;
+    }
+
+    return List::create(
+        Named("stems") = List::create(Named("tile") = stile, Named("x") = sx,
+                                      Named("y") = sy, Named("DBH") = sd,
+                                      Named("species") = ss),
+        Named("tiles") = List::create(Named("tile") = tile_id, Named("row") = tile_row,
+                                      Named("col") = tile_col, Named("x0") = tile_x0,
+                                      Named("y0") = tile_y0, Named("n") = tile_n,
+                                      Named("start") = tile_start),
+        Named("levels") = wrap(levels),
+        Named("n_skipped") = (double)n_skipped
+    );
+}
+
+// ==============================================================================
+// PER-PLOT TARGET METRICS
+// ==============================================================================
+// Computes the simulator's target metrics for every tile in parallel. Stems
+// must be grouped by tile (start/n from readStemMapCpp) with tile-local
+// coordinates. Clark-Evans R uses the same toroidal kd-tree as calcCE and
+// canopy cover the same raster rule as calc_canopy_cover, so targets derived
+// here are directly comparable with simulated stands.
+
+// [[Rcpp::plugins(openmp)]]
+// [[Rcpp::export]]
+List calcTileMetricsCpp(IntegerVector start, IntegerVector n, NumericVector x,
+                        NumericVector y, NumericVector dbh, NumericVector height,
+                        NumericVector crown_radius, NumericVector crown_length,
+                        NumericVector fuel_mass, IntegerVector species,
+                        int n_species, double tile_size, double grid_res = 0.5,
+                        int n_threads = 0) {
+    int n_tiles = start.size();
+    double area_m2 = tile_size * tile_size;
+
+    // Plain pointers only inside the parallel region
+    const int* pstart = start.begin();
+    const int* pn = n.begin();
+    const double* px = x.begin();
+    const double* py = y.begin();
+    const double* pd = dbh.begin();
+    const double* ph = height.begin();
+    const double* pr = crown_radius.begin();
+    const double* pl = crown_length.begin();
+    const double* pf = fuel_mass.begin();
+    const int* ps = species.begin();
+
+    vector<double> density(n_tiles), ce(n_tiles), mean_dbh(n_tiles), sd_dbh(n_tiles),
+                   mean_h(n_tiles), sd_h(n_tiles), cover(n_tiles), cfl(n_tiles),
+                   cbd(n_tiles), depth(n_tiles);
+    vector<double> props(n_tiles * n_species, 0.0);
+
+    #ifdef _OPENMP
+    if(n_threads > 0) {
+        omp_set_num_threads(n_threads);
+    }
+    #pragma omp parallel for schedule(dynamic, 1)
+    #endif
+    for(int t = 0; t < n_tiles; t++) {
+        int s0 = pstart[t], m = pn[t];
+        density[t] = m / (area_m2 / 10000.0);
+
+        double sum_d = 0, sum_d2 = 0, sum_h = 0, sum_h2 = 0;
+        double fuel = 0, volume = 0, length = 0;
+        for(int k = s0; k < s0 + m; k++) {
+            sum_d += pd[k];
+            sum_d2 += pd[k] * pd[k];
+            sum_h += ph[k];
+            sum_h2 += ph[k] * ph[k];
+            fuel += pf[k];
+            volume += M_PI * pr[k] * pr[k] * pl[k];
+            length += pl[k];
+            props[t * n_species + ps[k] - 1] += 1.0;
+        }
+        for(int s = 0; s < n_species; s++) {
+            props[t * n_species + s] = m > 0 ? props[t * n_species + s] / m : NA_REAL;
+        }
+        mean_dbh[t] = m > 0 ? sum_d / m : NA_REAL;
+        mean_h[t] = m > 0 ? sum_h / m : NA_REAL;
+        sd_dbh[t] = m > 1 ? sqrt(max(0.0, (sum_d2 - sum_d * sum_d / m) / (m - 1))) : NA_REAL;
+        sd_h[t] = m > 1 ? sqrt(max(0.0, (sum_h2 - sum_h * sum_h / m) / (m - 1))) : NA_REAL;
+        cfl[t] = fuel / area_m2;
+        cbd[t] = volume > 0 ? fuel / volume : 0.0;
+        depth[t] = m > 0 ? length / m : 0.0;
+        cover[t] = canopyCoverFraction(px + s0, py + s0, pr + s0, m, tile_size, grid_res);
+
+        if(m > 1) {
+            TorusKDTree tree(px + s0, py + s0, m, tile_size, tile_size);
+            double d1 = 0.0;
+            for(int k = 0; k < m; k++) {
+                d1 += sqrt(tree.nearest2(px[s0 + k], py[s0 + k], k, 0.0));
+            }
+            d1 /= m;
+            ce[t] = d1 / (0.5 * sqrt(area_m2 / m));
+        } else {
+            ce[t] = NA_REAL;
+        }
+    }
+
+    NumericMatrix species_props(n_tiles, n_species);
+    for(int t = 0; t < n_tiles; t++) {
+        for(int s = 0; s < n_species; s++) species_props(t, s) = props[t * n_species + s];
+    }
+
+    return List::create(
+        Named("density_ha") = wrap(density),
+        Named("clark_evans_r") = wrap(ce),
+        Named("mean_dbh") = wrap(mean_dbh),
+        Named("sd_dbh") = wrap(sd_dbh),
+        Named("mean_height") = wrap(mean_h),
+        Named("sd_height") = wrap(sd_h),
+        Named("canopy_cover") = wrap(cover),
+        Named("cfl") = wrap(cfl),
+        Named("cbd") = wrap(cbd),
+        Named("canopy_depth") = wrap(depth),
+        Named("species_props") = species_props
+    );
+}
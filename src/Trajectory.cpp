@@ -0,0 +1,84 @@
+#include <Rcpp.h>
+#include <vector>
+#include "TrajectoryLog.h"
+
+using namespace Rcpp;
+using namespace std;
+
+// ==============================================================================
+// TRAJECTORY LOG INTERFACE
+// ==============================================================================
+// R-facing wrappers around TrajectoryLog (TrajectoryLog.h). simulate_stand()
+// appends one record per accepted change; stand_at_iteration() reads back.
+
+// [[Rcpp::export]]
+SEXP trajectoryLogInit(IntegerVector number, NumericVector x, NumericVector y,
+                       IntegerVector species, NumericVector dbh,
+                       double coord_res = 0.001, double dbh_res = 0.001,
+                       int keyframe_every = 1000) {
+    if(coord_res <= 0 || dbh_res <= 0) stop("coord_res and dbh_res must be positive");
+    int n = number.size();
+    if(x.size() != n || y.size() != n || species.size() != n || dbh.size() != n) {
+        stop("number, x, y, species and dbh must have the same length");
+    }
+    vector<TrajectoryTree> trees(n);
+    for(int i = 0; i < n; i++) {
+        TrajectoryTree& t = trees[i];
+        t.number = number[i];
+        t.x = x[i];
+        t.y = y[i];
+        t.species = species[i];
+        t.dbh = dbh[i];
+    }
+    XPtr<TrajectoryLog> ptr(new TrajectoryLog(coord_res, dbh_res, keyframe_every), true);
+    ptr->start(trees);
+    return ptr;
+}
+
+// Append one accepted change (op 1 = move, 2 = species, 3 = DBH, 4 = add,
+// 5 = remove); fields not touched by op are ignored
+// [[Rcpp::export]]
+void trajectoryLogRecord(SEXP log, int iter, int op, int number, double x,
+                         double y, int species, double dbh) {
+    XPtr<TrajectoryLog> ptr(log);
+    if(op < TRAJ_MOVE || op > TRAJ_REMOVE) stop("op must be in 1..5");
+    if(iter < ptr->lastIteration()) stop("records must be in iteration order");
+    TrajectoryTree t;
+    t.number = number;
+    t.x = x;
+    t.y = y;
+    t.species = species;
+    t.dbh = dbh;
+    if(!ptr->record(iter, op, t)) {
+        stop("tree %d: unknown handle (or duplicate for an add)", number);
+    }
+}
+
+// Stand after all changes recorded up to and including `iter`
+// [[Rcpp::export]]
+List trajectoryLogStandAt(SEXP log, int iter) {
+    XPtr<TrajectoryLog> ptr(log);
+    vector<TrajectoryTree> stand = ptr->standAt(iter);
+    int n = (int)stand.size();
+    IntegerVector number(n), species(n);
+    NumericVector x(n), y(n), dbh(n);
+    for(int i = 0; i < n; i++) {
+        number[i] = stand[i].number;
+        x[i] = stand[i].x;
+        y[i] = stand[i].y;
+        species[i] = stand[i].species;
+        dbh[i] = stand[i].dbh;
+    }
+    return List::create(Named("Number") = number, Named("x") = x, Named("y") = y,
+                        Named("species") = species, Named("DBH") = dbh);
+}
+
+// [[Rcpp::export]]
+List trajectoryLogInfo(SEXP log) {
+    XPtr<TrajectoryLog> ptr(log);
+    return List::create(Named("records") = (double)ptr->records(),
+                        Named("keyframes") = ptr->keyframes(),
+                        Named("stream_bytes") = (double)ptr->streamBytes(),
+                        Named("keyframe_bytes") = (double)ptr->keyframeBytes(),
+                        Named("last_iteration") = ptr->lastIteration());
+}
@@ -0,0 +1,239 @@
+#ifndef EMPIRICALPATTERNR_TRAJECTORYLOG_H
+#define EMPIRICALPATTERNR_TRAJECTORYLOG_H
+
+#include <cmath>
+#include <vector>
+#include <stdint.h>
+#include <unordered_map>
+
+// ==============================================================================
+// ANNEALING TRAJECTORY LOG
+// ==============================================================================
+// Compact record of every accepted change to a stand, from which the stand at
+// any iteration can be rebuilt. Each change is appended to one byte stream as
+//
+//   varint  iteration - previous record's iteration
+//   byte    op (TRAJ_MOVE, TRAJ_SPECIES, TRAJ_DBH, TRAJ_ADD, TRAJ_REMOVE)
+//   varint  tree handle (the stand's Number)
+//   varint  changed fields only, quantized to coord_res / dbh_res
+//
+// which is 5-12 bytes for a typical plot. Every `keyframe_every` records the
+// whole stand is encoded the same way into a keyframe that remembers its
+// position in the stream; a reader decodes the last keyframe at or before the
+// requested iteration and replays the records after it.
+//
+// The log keeps its own copy of the stand, holding the quantized values, so a
+// keyframe and the records before it always describe the same stand and the
+// result does not depend on which keyframe a read starts from.
+
+enum { TRAJ_MOVE = 1, TRAJ_SPECIES = 2, TRAJ_DBH = 3, TRAJ_ADD = 4, TRAJ_REMOVE = 5 };
+
+struct TrajectoryTree {
+    int number;
+    double x, y, dbh;
+    int species;
+};
+
+class TrajectoryLog {
+public:
+    TrajectoryLog(double coord_res, double dbh_res, int keyframe_every)
+        : coord_res_(coord_res), dbh_res_(dbh_res), keyframe_every_(keyframe_every),
+          last_iter_(0), n_records_(0) {}
+
+    // Start the log with the stand at iteration 0
+    void start(const std::vector<TrajectoryTree>& trees) {
+        state_.clear();
+        slot_.clear();
+        for(size_t i = 0; i < trees.size(); i++) {
+            TrajectoryTree t = trees[i];
+            t.x = quantize(t.x, coord_res_);
+            t.y = quantize(t.y, coord_res_);
+            t.dbh = quantize(t.dbh, dbh_res_);
+            slot_[t.number] = (int)state_.size();
+            state_.push_back(t);
+        }
+        writeKeyframe(0);
+    }
+
+    // Record an accepted change; `t` carries the tree's new fields (only the
+    // fields of `op` are read). Returns false for an unknown handle.
+    bool record(int iter, int op, const TrajectoryTree& t) {
+        TrajectoryTree q = t;
+        q.x = quantize(t.x, coord_res_);
+        q.y = quantize(t.y, coord_res_);
+        q.dbh = quantize(t.dbh, dbh_res_);
+        if(!apply(state_, slot_, op, q)) return false;
+
+        putVarint(stream_, (uint64_t)(iter - last_iter_));
+        stream_.push_back((uint8_t)op);
+        putVarint(stream_, zigzag(t.number));
+        putFields(stream_, op, q);
+        last_iter_ = iter;
+        n_records_++;
+        if(keyframe_every_ > 0 && n_records_ % keyframe_every_ == 0) writeKeyframe(iter);
+        return true;
+    }
+
+    // Stand after all changes recorded at iterations <= iter
+    std::vector<TrajectoryTree> standAt(int iter) const {
+        size_t k = 0;
+        size_t lo = 0, hi = keyframes_.size();
+        while(hi - lo > 1) {
+            size_t mid = (lo + hi) / 2;
+            if(keyframes_[mid].iter <= iter) lo = mid; else hi = mid;
+        }
+        k = lo;
+
+        std::vector<TrajectoryTree> stand;
+        std::unordered_map<int, int> slot;
+        const Keyframe& kf = keyframes_[k];
+        size_t pos = 0;
+        int n = (int)getVarint(kf.blob, pos);
+        for(int i = 0; i < n; i++) {
+            TrajectoryTree t;
+            t.number = unzigzag(getVarint(kf.blob, pos));
+            getFields(kf.blob, pos, TRAJ_ADD, t);
+            slot[t.number] = (int)stand.size();
+            stand.push_back(t);
+        }
+
+        int cur = kf.iter;
+        pos = kf.offset;
+        while(pos < stream_.size()) {
+            size_t rec = pos;
+            int next = cur + (int)getVarint(stream_, pos);
+            if(next > iter) {
+                pos = rec;
+                break;
+            }
+            cur = next;
+            int op = stream_[pos++];
+            TrajectoryTree t;
+            t.number = unzigzag(getVarint(stream_, pos));
+            getFields(stream_, pos, op, t);
+            apply(stand, slot, op, t);
+        }
+        return stand;
+    }
+
+    int lastIteration() const { return last_iter_; }
+    long records() const { return n_records_; }
+    int keyframes() const { return (int)keyframes_.size(); }
+    size_t streamBytes() const { return stream_.size(); }
+    size_t keyframeBytes() const {
+        size_t b = 0;
+        for(size_t k = 0; k < keyframes_.size(); k++) b += keyframes_[k].blob.size();
+        return b;
+    }
+
+private:
+    struct Keyframe {
+        int iter;
+        size_t offset;
+        std::vector<uint8_t> blob;
+    };
+
+    double coord_res_, dbh_res_;
+    int keyframe_every_;
+    int last_iter_;
+    long n_records_;
+    std::vector<uint8_t> stream_;
+    std::vector<Keyframe> keyframes_;
+    std::vector<TrajectoryTree> state_;
+    std::unordered_map<int, int> slot_;
+
+    static double quantize(double v, double res) { return (double)llround(v / res) * res; }
+
+    static uint64_t zigzag(int64_t v) { return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63); }
+    static int64_t unzigzagWide(uint64_t v) { return (int64_t)(v >> 1) ^ -(int64_t)(v & 1); }
+    static int unzigzag(uint64_t v) { return (int)unzigzagWide(v); }
+
+    static void putVarint(std::vector<uint8_t>& out, uint64_t v) {
+        while(v >= 0x80) {
+            out.push_back((uint8_t)(v | 0x80));
+            v >>= 7;
+        }
+        out.push_back((uint8_t)v);
+    }
+
+    static uint64_t getVarint(const std::vector<uint8_t>& in, size_t& pos) {
+        uint64_t v = 0;
+        int shift = 0;
+        while(true) {
+            uint8_t b = in[pos++];
+            v |= (uint64_t)(b & 0x7f) << shift;
+            if(!(b & 0x80)) break;
+            shift += 7;
+        }
+        return v;
+    }
+
+    void putFields(std::vector<uint8_t>& out, int op, const TrajectoryTree& t) const {
+        if(op == TRAJ_MOVE || op == TRAJ_ADD) {
+            putVarint(out, zigzag(llround(t.x / coord_res_)));
+            putVarint(out, zigzag(llround(t.y / coord_res_)));
+        }
+        if(op == TRAJ_SPECIES || op == TRAJ_ADD) putVarint(out, (uint64_t)t.species);
+        if(op == TRAJ_DBH || op == TRAJ_ADD) {
+            putVarint(out, zigzag(llround(t.dbh / dbh_res_)));
+        }
+    }
+
+    void getFields(const std::vector<uint8_t>& in, size_t& pos, int op,
+                   TrajectoryTree& t) const {
+        if(op == TRAJ_MOVE || op == TRAJ_ADD) {
+            t.x = (double)unzigzagWide(getVarint(in, pos)) * coord_res_;
+            t.y = (double)unzigzagWide(getVarint(in, pos)) * coord_res_;
+        }
+        if(op == TRAJ_SPECIES || op == TRAJ_ADD) t.species = (int)getVarint(in, pos);
+        if(op == TRAJ_DBH || op == TRAJ_ADD) {
+            t.dbh = (double)unzigzagWide(getVarint(in, pos)) * dbh_res_;
+        }
+    }
+
+    // Apply one change to a stand; removals swap the last tree into the gap
+    static bool apply(std::vector<TrajectoryTree>& stand,
+                      std::unordered_map<int, int>& slot, int op,
+                      const TrajectoryTree& t) {
+        if(op == TRAJ_ADD) {
+            if(slot.count(t.number)) return false;
+            slot[t.number] = (int)stand.size();
+            stand.push_back(t);
+            return true;
+        }
+        std::unordered_map<int, int>::iterator it = slot.find(t.number);
+        if(it == slot.end()) return false;
+        TrajectoryTree& s = stand[it->second];
+        switch(op) {
+        case TRAJ_MOVE: s.x = t.x; s.y = t.y; break;
+        case TRAJ_SPECIES: s.species = t.species; break;
+        case TRAJ_DBH: s.dbh = t.dbh; break;
+        case TRAJ_REMOVE: {
+            int i = it->second;
+            slot.erase(it);
+            if(i != (int)stand.size() - 1) {
+                stand[i] = stand.back();
+                slot[stand[i].number] = i;
+            }
+            stand.pop_back();
+            break;
+        }
+        default: return false;
+        }
+        return true;
+    }
+
+    void writeKeyframe(int iter) {
+        Keyframe kf;
+        kf.iter = iter;
+        kf.offset = stream_.size();
+        putVarint(kf.blob, (uint64_t)state_.size());
+        for(size_t i = 0; i < state_.size(); i++) {
+            putVarint(kf.blob, zigzag(state_[i].number));
+            putFields(kf.blob, TRAJ_ADD, state_[i]);
+        }
+        keyframes_.push_back(kf);
+    }
+};
+
+#endif